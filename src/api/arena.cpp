@@ -0,0 +1,308 @@
+#include "arena.h"
+
+#include "utils/error.h"
+#include "utils/log.h"
+
+#include <glad/gl.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace api::arena {
+  using namespace utils;
+
+  GeometryArena::GeometryArena(std::size_t vertex_capacity,
+                               std::size_t index_capacity)
+    : m_vertex_space { vertex_capacity }
+    , m_index_space { index_capacity } {
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_ebo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 vertex_capacity * VertexStride * sizeof(float),
+                 nullptr,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 index_capacity * sizeof(unsigned int),
+                 nullptr,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    configureVertexArray();
+  }
+
+  GeometryArena::~GeometryArena() {
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteVertexArrays(1, &m_vao);
+  }
+
+  void GeometryArena::configureVertexArray() const {
+    glBindVertexArray(m_vao);
+    {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+      glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+      {
+        // position attribute
+        glVertexAttribPointer(0,
+                              3,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              VertexStride * sizeof(float),
+                              (void*)0);
+        glEnableVertexAttribArray(0);
+        // normal attribute
+        glVertexAttribPointer(1,
+                              3,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              VertexStride * sizeof(float),
+                              (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+        // uv attribute
+        glVertexAttribPointer(2,
+                              2,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              VertexStride * sizeof(float),
+                              (void*)(6 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+      }
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    // the element buffer binding is vao state and stays attached
+    glBindVertexArray(0);
+  }
+
+  auto GeometryArena::allocate(const Geometry& geometry) -> unsigned int {
+    if (!geometry.buffersGenerated()) {
+      raise::error("buffers not generated for geometry: " + geometry.name());
+    }
+    const auto& vertices     = geometry.gpuVertices();
+    const auto& indices      = geometry.gpuIndices();
+    const auto  vertex_count = vertices.size() / VertexStride;
+    const auto  index_count  = indices.size();
+
+    // an empty stream takes no space : it sits at offset 0 and draws nothing
+    const auto reserve = [](FreeList& space, std::size_t count) {
+      return count == 0 ? std::size_t { 0 } : space.allocate(count);
+    };
+    auto base_vertex = reserve(m_vertex_space, vertex_count);
+    auto first_index = reserve(m_index_space, index_count);
+    if (base_vertex == FreeList::npos || first_index == FreeList::npos) {
+      if (base_vertex != FreeList::npos) {
+        m_vertex_space.release(base_vertex, vertex_count);
+      }
+      if (first_index != FreeList::npos) {
+        m_index_space.release(first_index, index_count);
+      }
+      if (m_vertex_space.available() >= vertex_count &&
+          m_index_space.available() >= index_count) {
+        // enough room in total, just fragmented
+        defragment();
+      } else {
+        relocate(std::max(2 * m_vertex_space.capacity(),
+                          m_vertex_space.capacity() + vertex_count),
+                 std::max(2 * m_index_space.capacity(),
+                          m_index_space.capacity() + index_count));
+      }
+      base_vertex = reserve(m_vertex_space, vertex_count);
+      first_index = reserve(m_index_space, index_count);
+      if (base_vertex == FreeList::npos || first_index == FreeList::npos) {
+        raise::error("geometry arena allocation failed");
+      }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER,
+                    base_vertex * VertexStride * sizeof(float),
+                    vertices.size() * sizeof(float),
+                    vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_ebo);
+    glBufferSubData(GL_COPY_WRITE_BUFFER,
+                    first_index * sizeof(unsigned int),
+                    indices.size() * sizeof(unsigned int),
+                    indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    const auto range = Range {
+      base_vertex, vertex_count, first_index, index_count, true,
+      geometry.lods()
+    };
+    if (m_free_handles.empty()) {
+      m_ranges.push_back(range);
+      return static_cast<unsigned int>(m_ranges.size() - 1);
+    } else {
+      const auto handle = m_free_handles.back();
+      m_free_handles.pop_back();
+      m_ranges[handle] = range;
+      return handle;
+    }
+  }
+
+  void GeometryArena::release(unsigned int handle) {
+    auto& r = m_ranges[handle];
+    if (!r.live) {
+      raise::error("geometry arena handle already released");
+    }
+    m_vertex_space.release(r.base_vertex, r.vertex_count);
+    m_index_space.release(r.first_index, r.index_count);
+    r.live = false;
+    m_free_handles.push_back(handle);
+  }
+
+  void GeometryArena::defragment() {
+    relocate(m_vertex_space.capacity(), m_index_space.capacity());
+  }
+
+  void GeometryArena::relocate(std::size_t vertex_capacity,
+                               std::size_t index_capacity) {
+    log::log(log::DEBUG,
+             "relocating geometry arena : " + std::to_string(vertex_capacity) +
+               " vertices, " + std::to_string(index_capacity) + " indices");
+    unsigned int vbo, ebo;
+    glGenBuffers(1, &vbo);
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 vertex_capacity * VertexStride * sizeof(float),
+                 nullptr,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+    glBufferData(GL_COPY_WRITE_BUFFER,
+                 index_capacity * sizeof(unsigned int),
+                 nullptr,
+                 GL_STATIC_DRAW);
+
+    // pack live ranges in their current order so copies stay sequential
+    std::vector<unsigned int> order(m_ranges.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+      return m_ranges[a].base_vertex < m_ranges[b].base_vertex;
+    });
+    std::size_t next_vertex = 0, next_index = 0;
+    for (const auto handle : order) {
+      auto& r = m_ranges[handle];
+      if (!r.live) {
+        continue;
+      }
+      glBindBuffer(GL_COPY_READ_BUFFER, m_vbo);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                          GL_COPY_WRITE_BUFFER,
+                          r.base_vertex * VertexStride * sizeof(float),
+                          next_vertex * VertexStride * sizeof(float),
+                          r.vertex_count * VertexStride * sizeof(float));
+      glBindBuffer(GL_COPY_READ_BUFFER, m_ebo);
+      glBindBuffer(GL_COPY_WRITE_BUFFER, ebo);
+      glCopyBufferSubData(GL_COPY_READ_BUFFER,
+                          GL_COPY_WRITE_BUFFER,
+                          r.first_index * sizeof(unsigned int),
+                          next_index * sizeof(unsigned int),
+                          r.index_count * sizeof(unsigned int));
+      r.base_vertex  = next_vertex;
+      r.first_index  = next_index;
+      next_vertex   += r.vertex_count;
+      next_index    += r.index_count;
+    }
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteBuffers(1, &m_ebo);
+    m_vbo = vbo;
+    m_ebo = ebo;
+    m_vertex_space.grow(vertex_capacity);
+    m_index_space.grow(index_capacity);
+    m_vertex_space.reset(next_vertex);
+    m_index_space.reset(next_index);
+    configureVertexArray();
+  }
+
+  void GeometryArena::bind() const {
+    glBindVertexArray(m_vao);
+  }
+
+  void GeometryArena::bindInstances(unsigned int instance_vbo,
+                                    std::size_t  offset) const {
+    glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+    {
+      // model matrix attribute : four vec4 columns at locations 3..6
+      for (auto c = 0u; c < 4; ++c) {
+        glVertexAttribPointer(3 + c,
+                              4,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              sizeof(Instance),
+                              (void*)(offset + offsetof(Instance, model) +
+                                      c * 4 * sizeof(float)));
+        glEnableVertexAttribArray(3 + c);
+        glVertexAttribDivisor(3 + c, 1);
+      }
+      // normal matrix attribute : three vec3 columns at locations 8..10
+      for (auto c = 0u; c < 3; ++c) {
+        glVertexAttribPointer(8 + c,
+                              3,
+                              GL_FLOAT,
+                              GL_FALSE,
+                              sizeof(Instance),
+                              (void*)(offset + offsetof(Instance, normal) +
+                                      c * 4 * sizeof(float)));
+        glEnableVertexAttribArray(8 + c);
+        glVertexAttribDivisor(8 + c, 1);
+      }
+      // material index attribute
+      glVertexAttribIPointer(7,
+                             1,
+                             GL_UNSIGNED_INT,
+                             sizeof(Instance),
+                             (void*)(offset + offsetof(Instance, matIdx)));
+      glEnableVertexAttribArray(7);
+      glVertexAttribDivisor(7, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  void GeometryArena::draw(unsigned int handle,
+                           unsigned int instances,
+                           unsigned int level) const {
+    const auto& r = range(handle);
+    if (r.index_count == 0 || r.lods.empty()) {
+      return;
+    }
+    const auto& lod = r.lods[std::min<std::size_t>(level, r.lods.size() - 1)];
+    glDrawElementsInstancedBaseVertex(
+      GL_TRIANGLES,
+      static_cast<GLsizei>(lod.count),
+      GL_UNSIGNED_INT,
+      (void*)((r.first_index + lod.first) * sizeof(unsigned int)),
+      static_cast<GLsizei>(instances),
+      static_cast<GLint>(r.base_vertex));
+  }
+
+  auto GeometryArena::range(unsigned int handle) const -> const Range& {
+    if (handle >= m_ranges.size() || !m_ranges[handle].live) {
+      raise::error("invalid geometry arena handle");
+    }
+    return m_ranges[handle];
+  }
+
+  void GeometryArena::print() const {
+    printf("vertices [%ld / %ld, %ld free blocks] : indices [%ld / %ld, %ld "
+           "free blocks]",
+           m_vertex_space.capacity() - m_vertex_space.available(),
+           m_vertex_space.capacity(),
+           m_vertex_space.blocks(),
+           m_index_space.capacity() - m_index_space.available(),
+           m_index_space.capacity(),
+           m_index_space.blocks());
+  }
+
+} // namespace api::arena
@@ -0,0 +1,79 @@
+#ifndef API_ARENA_H
+#define API_ARENA_H
+
+#include "api/geometry.h"
+#include "utils/freelist.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace api::arena {
+  using namespace api::geometry;
+  using namespace utils::freelist;
+
+  // floats per interleaved vertex : position, normal, uv
+  static constexpr std::size_t VertexStride { 8 };
+
+  /*
+   * one vertex and one index buffer behind a single vao, sub-allocated
+   * between all geometries of a scene; each geometry draws from its own
+   * base-vertex / first-index range
+   */
+  class GeometryArena {
+  public:
+    struct Range {
+      std::size_t base_vertex;
+      std::size_t vertex_count;
+      std::size_t first_index;
+      std::size_t index_count;
+      bool        live;
+      // index slices of each level, relative to first_index
+      std::vector<Lod> lods;
+    };
+
+  private:
+    unsigned int m_vao;
+    unsigned int m_vbo;
+    unsigned int m_ebo;
+
+    FreeList                  m_vertex_space;
+    FreeList                  m_index_space;
+    std::vector<Range>        m_ranges;
+    std::vector<unsigned int> m_free_handles;
+
+    void configureVertexArray() const;
+    // moves every live range into freshly allocated, compacted buffers
+    void relocate(std::size_t, std::size_t);
+
+  public:
+    GeometryArena(std::size_t = 1 << 16, std::size_t = 1 << 18);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena&) = delete;
+
+    // uploads the gpu-ready streams of a geometry; returns its handle
+    [[nodiscard]]
+    auto allocate(const Geometry&) -> unsigned int;
+    void release(unsigned int);
+    void defragment();
+
+    void bind() const;
+    // points the instance attributes of the vao at an instance buffer
+    void bindInstances(unsigned int, std::size_t) const;
+    void draw(unsigned int, unsigned int, unsigned int level = 0) const;
+
+    void print() const;
+
+    // accessors
+    [[nodiscard]]
+    auto range(unsigned int) const -> const Range&;
+
+    [[nodiscard]]
+    auto vao() const -> unsigned int {
+      return m_vao;
+    }
+  };
+
+} // namespace api::arena
+
+#endif // API_ARENA_H
@@ -0,0 +1,168 @@
+#include "bounds.h"
+
+#include "utils/jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64)
+  #include <xmmintrin.h>
+  #define BOUNDS_SSE
+#endif
+
+namespace api::bounds {
+
+  auto merge(const AABB& a, const AABB& b) -> AABB {
+    return { glm::min(a.min, b.min), glm::max(a.max, b.max) };
+  }
+
+  auto aabb(const std::vector<float>& positions) -> AABB {
+    if (positions.size() < 3) {
+      return {};
+    }
+    auto box = AABB { vec_t(std::numeric_limits<float>::max()),
+                      vec_t(std::numeric_limits<float>::lowest()) };
+    for (auto i = 0u; i + 2 < positions.size(); i += 3) {
+      const auto p = vec_t(positions[i], positions[i + 1], positions[i + 2]);
+      box.min      = glm::min(box.min, p);
+      box.max      = glm::max(box.max, p);
+    }
+    return box;
+  }
+
+  auto sphere(const std::vector<float>& positions) -> Sphere {
+    // centered on the box : not minimal, but cheap and stable
+    const auto center = aabb(positions).center();
+    auto       radius = 0.0f;
+    for (auto i = 0u; i + 2 < positions.size(); i += 3) {
+      const auto p = vec_t(positions[i], positions[i + 1], positions[i + 2]);
+      radius       = std::max(radius, glm::length(p - center));
+    }
+    return { center, radius };
+  }
+
+  auto transformed(const AABB& box, const transform_t& m) -> AABB {
+    // center moves with the matrix, extent is rotated by |m|
+    const auto c = vec_t(m * glm::vec4(box.center(), 1.0f));
+    const auto e = box.extent();
+    auto       r = vec_t(0.0f);
+    for (auto col = 0; col < 3; ++col) {
+      r += glm::abs(vec_t(m[col])) * e[col];
+    }
+    return { c - r, c + r };
+  }
+
+  auto transformed(const Sphere& s, const transform_t& m) -> Sphere {
+    const auto scale = std::max({ glm::length(vec_t(m[0])),
+                                  glm::length(vec_t(m[1])),
+                                  glm::length(vec_t(m[2])) });
+    return { vec_t(m * glm::vec4(s.center, 1.0f)), s.radius * scale };
+  }
+
+  Frustum::Frustum(const transform_t& vp) {
+    const auto row = [&](int r) {
+      return glm::vec4(vp[0][r], vp[1][r], vp[2][r], vp[3][r]);
+    };
+    m_planes = { row(3) + row(0), row(3) - row(0), row(3) + row(1),
+                 row(3) - row(1), row(3) + row(2), row(3) - row(2) };
+    for (auto& p : m_planes) {
+      p /= glm::length(vec_t(p));
+    }
+  }
+
+  auto Frustum::intersects(const Sphere& s) const -> bool {
+    for (const auto& p : m_planes) {
+      if (glm::dot(vec_t(p), s.center) + p.w < -s.radius) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  auto Frustum::intersects(const AABB& box) const -> bool {
+    const auto c = box.center();
+    const auto e = box.extent();
+    for (const auto& p : m_planes) {
+      // projected radius of the box onto the plane normal
+      const auto r = glm::dot(e, glm::abs(vec_t(p)));
+      if (glm::dot(vec_t(p), c) + p.w < -r) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  auto Frustum::classify(const AABB& box) const -> Containment {
+    const auto c      = box.center();
+    const auto e      = box.extent();
+    auto       result = Inside;
+    for (const auto& p : m_planes) {
+      const auto r = glm::dot(e, glm::abs(vec_t(p)));
+      const auto d = glm::dot(vec_t(p), c) + p.w;
+      if (d < -r) {
+        return Outside;
+      } else if (d < r) {
+        result = Intersect;
+      }
+    }
+    return result;
+  }
+
+  void SphereSoA::clear() {
+    m_x.clear();
+    m_y.clear();
+    m_z.clear();
+    m_r.clear();
+  }
+
+  void SphereSoA::push(const Sphere& s) {
+    m_x.push_back(s.center.x);
+    m_y.push_back(s.center.y);
+    m_z.push_back(s.center.z);
+    m_r.push_back(s.radius);
+  }
+
+  void SphereSoA::cull(const Frustum&              frustum,
+                       std::vector<unsigned char>& visible) const {
+    visible.resize(size());
+    // chunks stay multiples of 4 so only the last one has a scalar tail
+    utils::jobs::pool().parallelFor(
+      0, (size() + 3) / 4, 1024, [&](std::size_t first, std::size_t last) {
+        cull(frustum, visible, 4 * first, std::min(size(), 4 * last));
+      });
+  }
+
+  void SphereSoA::cull(const Frustum&              frustum,
+                       std::vector<unsigned char>& visible,
+                       std::size_t                 first,
+                       std::size_t                 last) const {
+    const auto& planes = frustum.planes();
+    auto        i      = first;
+#ifdef BOUNDS_SSE
+    for (; i + 4 <= last; i += 4) {
+      const auto zero = _mm_setzero_ps();
+      const auto x    = _mm_loadu_ps(&m_x[i]);
+      const auto y    = _mm_loadu_ps(&m_y[i]);
+      const auto z    = _mm_loadu_ps(&m_z[i]);
+      const auto r    = _mm_sub_ps(zero, _mm_loadu_ps(&m_r[i]));
+      auto       in   = _mm_cmpeq_ps(zero, zero);
+      for (const auto& p : planes) {
+        auto d = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(p.x)), _mm_set1_ps(p.w));
+        d      = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(p.y)));
+        d      = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(p.z)));
+        in     = _mm_and_ps(in, _mm_cmpge_ps(d, r));
+      }
+      const auto mask = _mm_movemask_ps(in);
+      for (auto k = 0u; k < 4; ++k) {
+        visible[i + k] = (mask >> k) & 1;
+      }
+    }
+#endif
+    for (; i < last; ++i) {
+      visible[i] = frustum.intersects(
+        Sphere { vec_t(m_x[i], m_y[i], m_z[i]), m_r[i] });
+    }
+  }
+
+} // namespace api::bounds
@@ -0,0 +1,102 @@
+#ifndef API_BOUNDS_H
+#define API_BOUNDS_H
+
+#include "global.h"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace api::bounds {
+
+  struct AABB {
+    vec_t min { 0.0f };
+    vec_t max { 0.0f };
+
+    [[nodiscard]]
+    auto center() const -> vec_t {
+      return 0.5f * (min + max);
+    }
+
+    [[nodiscard]]
+    auto extent() const -> vec_t {
+      return 0.5f * (max - min);
+    }
+
+    [[nodiscard]]
+    auto area() const -> float {
+      const auto d = max - min;
+      return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+    }
+  };
+
+  enum Containment : unsigned char {
+    Outside   = 0,
+    Intersect = 1,
+    Inside    = 2,
+  };
+
+  struct Sphere {
+    vec_t center { 0.0f };
+    float radius { 0.0f };
+  };
+
+  auto merge(const AABB&, const AABB&) -> AABB;
+
+  // bounds of a packed xyz position array
+  auto aabb(const std::vector<float>&) -> AABB;
+  auto sphere(const std::vector<float>&) -> Sphere;
+
+  // conservative bounds after an affine transform
+  auto transformed(const AABB&, const transform_t&) -> AABB;
+  auto transformed(const Sphere&, const transform_t&) -> Sphere;
+
+  /*
+   * six normalized planes (left, right, bottom, top, near, far) extracted
+   * from a view-projection matrix; normals point into the frustum
+   */
+  class Frustum {
+    std::array<glm::vec4, 6> m_planes;
+
+  public:
+    Frustum() = default;
+    explicit Frustum(const transform_t&);
+
+    [[nodiscard]]
+    auto intersects(const Sphere&) const -> bool;
+    [[nodiscard]]
+    auto intersects(const AABB&) const -> bool;
+    [[nodiscard]]
+    auto classify(const AABB&) const -> Containment;
+
+    [[nodiscard]]
+    auto planes() const -> const std::array<glm::vec4, 6>& {
+      return m_planes;
+    }
+  };
+
+  // spheres laid out component-wise so the frustum test runs 4-wide
+  class SphereSoA {
+    std::vector<float> m_x, m_y, m_z, m_r;
+
+    void cull(const Frustum&,
+              std::vector<unsigned char>&,
+              std::size_t,
+              std::size_t) const;
+
+  public:
+    void clear();
+    void push(const Sphere&);
+
+    [[nodiscard]]
+    auto size() const -> std::size_t {
+      return m_x.size();
+    }
+
+    // writes 1 for every sphere touching the frustum, 0 otherwise
+    void cull(const Frustum&, std::vector<unsigned char>&) const;
+  };
+
+} // namespace api::bounds
+
+#endif // API_BOUNDS_H
@@ -0,0 +1,344 @@
+#include "bvh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <numeric>
+
+namespace api::bvh {
+
+  namespace {
+    auto empty() -> AABB {
+      return { vec_t(std::numeric_limits<float>::max()),
+               vec_t(std::numeric_limits<float>::lowest()) };
+    }
+
+    // entry distance of a ray into a box, infinity on a miss
+    auto slab(const AABB&  box,
+              const vec_t& origin,
+              const vec_t& inv,
+              float        tmax) -> float {
+      const auto t0   = (box.min - origin) * inv;
+      const auto t1   = (box.max - origin) * inv;
+      const auto tmin = glm::min(t0, t1);
+      const auto tfar = glm::max(t0, t1);
+      const auto near = std::max({ tmin.x, tmin.y, tmin.z, 0.0f });
+      const auto far  = std::min({ tfar.x, tfar.y, tfar.z, tmax });
+      return near <= far ? near : std::numeric_limits<float>::infinity();
+    }
+
+    auto distance2(const AABB& box, const vec_t& p) -> float {
+      const auto d = glm::max(glm::max(box.min - p, p - box.max), vec_t(0.0f));
+      return glm::dot(d, d);
+    }
+  } // namespace
+
+  void BVH::build(const std::vector<AABB>& boxes) {
+    clear();
+    m_boxes = boxes;
+    m_order.resize(boxes.size());
+    std::iota(m_order.begin(), m_order.end(), 0u);
+    m_leaf_of.assign(boxes.size(), npos);
+    if (boxes.empty()) {
+      return;
+    }
+    m_nodes.reserve(2 * boxes.size());
+    subdivide(npos, 0, static_cast<unsigned int>(boxes.size()));
+    m_build_cost = cost();
+    m_moved      = false;
+  }
+
+  void BVH::rebuild() {
+    const auto boxes = m_boxes;
+    build(boxes);
+  }
+
+  void BVH::clear() {
+    m_nodes.clear();
+    m_boxes.clear();
+    m_order.clear();
+    m_leaf_of.clear();
+    m_build_cost = 0.0f;
+    m_moved      = false;
+  }
+
+  auto BVH::subdivide(unsigned int parent,
+                      unsigned int first,
+                      unsigned int count) -> unsigned int {
+    const auto index = static_cast<unsigned int>(m_nodes.size());
+    m_nodes.push_back({ {}, parent, npos, npos, first, count });
+    enclose(m_nodes[index]);
+
+    // split along the widest axis of the primitive centroids
+    auto centroids = empty();
+    for (auto i = first; i < first + count; ++i) {
+      const auto c  = m_boxes[m_order[i]].center();
+      centroids.min = glm::min(centroids.min, c);
+      centroids.max = glm::max(centroids.max, c);
+    }
+    const auto extent = centroids.max - centroids.min;
+    auto       axis   = 0;
+    if (extent.y > extent[axis]) {
+      axis = 1;
+    }
+    if (extent.z > extent[axis]) {
+      axis = 2;
+    }
+    const auto begin = m_order.begin() + first;
+    const auto end   = begin + count;
+    const auto key   = [&](unsigned int p) {
+      return m_boxes[p].center()[axis];
+    };
+
+    auto mid = count / 2;
+    if (count <= 1 || extent[axis] <= 0.0f) {
+      if (count <= MaxLeafSize) {
+        for (auto i = first; i < first + count; ++i) {
+          m_leaf_of[m_order[i]] = index;
+        }
+        return index;
+      }
+      // coincident centroids : any balanced split will do
+    } else {
+      struct Bin {
+        AABB         box;
+        unsigned int count;
+      };
+      std::vector<Bin> bins(SahBins, { empty(), 0 });
+      const auto       scale = SahBins / extent[axis];
+      const auto       bin   = [&](unsigned int p) {
+        return std::min(
+          SahBins - 1,
+          static_cast<unsigned int>((key(p) - centroids.min[axis]) * scale));
+      };
+      for (auto it = begin; it != end; ++it) {
+        auto& b = bins[bin(*it)];
+        b.box   = merge(b.box, m_boxes[*it]);
+        ++b.count;
+      }
+      // sweep from the right, then evaluate every plane from the left
+      std::vector<float> right_cost(SahBins, 0.0f);
+      auto               acc  = empty();
+      auto               accn = 0u;
+      for (auto i = SahBins - 1; i > 0; --i) {
+        acc               = merge(acc, bins[i].box);
+        accn             += bins[i].count;
+        right_cost[i - 1] = accn > 0 ? acc.area() * accn : 0.0f;
+      }
+      auto best_cost  = std::numeric_limits<float>::max();
+      auto best_plane = 0u;
+      acc             = empty();
+      accn            = 0;
+      for (auto i = 0u; i + 1 < SahBins; ++i) {
+        acc           = merge(acc, bins[i].box);
+        accn         += bins[i].count;
+        const auto c  = (accn > 0 ? acc.area() * accn : 0.0f) + right_cost[i];
+        if (c < best_cost) {
+          best_cost  = c;
+          best_plane = i;
+        }
+      }
+      const auto leaf_cost = m_nodes[index].box.area() * count;
+      if (count <= MaxLeafSize && best_cost >= leaf_cost) {
+        for (auto i = first; i < first + count; ++i) {
+          m_leaf_of[m_order[i]] = index;
+        }
+        return index;
+      }
+      mid = static_cast<unsigned int>(
+        std::partition(begin,
+                       end,
+                       [&](unsigned int p) { return bin(p) <= best_plane; }) -
+        begin);
+    }
+    if (mid == 0 || mid == count) {
+      mid = count / 2;
+      std::nth_element(begin, begin + mid, end, [&](auto a, auto b) {
+        return key(a) < key(b);
+      });
+    }
+
+    const auto left      = subdivide(index, first, mid);
+    const auto right     = subdivide(index, first + mid, count - mid);
+    m_nodes[index].left  = left;
+    m_nodes[index].right = right;
+    m_nodes[index].count = 0;
+    return index;
+  }
+
+  void BVH::enclose(Node& node) const {
+    if (node.count > 0) {
+      node.box = m_boxes[m_order[node.first]];
+      for (auto i = node.first + 1; i < node.first + node.count; ++i) {
+        node.box = merge(node.box, m_boxes[m_order[i]]);
+      }
+    } else {
+      node.box = merge(m_nodes[node.left].box, m_nodes[node.right].box);
+    }
+  }
+
+  void BVH::update(unsigned int primitive, const AABB& box) {
+    m_boxes[primitive] = box;
+    m_moved            = true;
+    // regrow the path to the root until a box stops changing
+    for (auto n = m_leaf_of[primitive]; n != npos; n = m_nodes[n].parent) {
+      auto&      node = m_nodes[n];
+      const auto old  = node.box;
+      enclose(node);
+      if (old.min == node.box.min && old.max == node.box.max) {
+        break;
+      }
+    }
+  }
+
+  void BVH::refit() {
+    m_moved = true;
+    // children are always stored after their parent
+    for (auto n = m_nodes.size(); n-- > 0;) {
+      enclose(m_nodes[n]);
+    }
+  }
+
+  auto BVH::cost() const -> float {
+    if (m_nodes.empty()) {
+      return 0.0f;
+    }
+    auto total = 0.0f;
+    for (const auto& node : m_nodes) {
+      total += node.box.area() * (node.count > 0 ? node.count : 1);
+    }
+    return total / std::max(m_nodes[0].box.area(), 1e-12f);
+  }
+
+  auto BVH::degraded() -> bool {
+    if (!m_moved) {
+      return false;
+    }
+    m_moved = false;
+    return cost() > 1.5f * m_build_cost;
+  }
+
+  void BVH::cull(const Frustum&              frustum,
+                 std::vector<unsigned char>& result) const {
+    result.assign(m_boxes.size(), Outside);
+    if (m_nodes.empty()) {
+      return;
+    }
+    // (node, already known to be inside)
+    std::vector<std::pair<unsigned int, bool>> stack { { 0, false } };
+    while (!stack.empty()) {
+      const auto [n, inside] = stack.back();
+      stack.pop_back();
+      const auto& node  = m_nodes[n];
+      const auto  state = inside ? Inside : frustum.classify(node.box);
+      if (state == Outside) {
+        continue;
+      }
+      if (node.count > 0) {
+        for (auto i = node.first; i < node.first + node.count; ++i) {
+          result[m_order[i]] = state;
+        }
+      } else {
+        stack.push_back({ node.left, state == Inside });
+        stack.push_back({ node.right, state == Inside });
+      }
+    }
+  }
+
+  auto BVH::raycast(const vec_t&                      origin,
+                    const vec_t&                      direction,
+                    float                             tmax,
+                    const std::vector<unsigned char>& skip) const -> Hit {
+    auto best = Hit { npos, tmax };
+    if (m_nodes.empty()) {
+      return best;
+    }
+    const auto inv = vec_t(1.0f) / direction;
+    std::vector<std::pair<unsigned int, float>> stack;
+    stack.push_back({ 0, slab(m_nodes[0].box, origin, inv, tmax) });
+    while (!stack.empty()) {
+      const auto [n, t] = stack.back();
+      stack.pop_back();
+      if (t > best.t) {
+        continue;
+      }
+      const auto& node = m_nodes[n];
+      if (node.count > 0) {
+        for (auto i = node.first; i < node.first + node.count; ++i) {
+          if (!skip.empty() && skip[m_order[i]]) {
+            continue;
+          }
+          const auto tp = slab(m_boxes[m_order[i]], origin, inv, best.t);
+          if (tp < best.t) {
+            best = { m_order[i], tp };
+          }
+        }
+      } else {
+        const auto& lbox = m_nodes[node.left].box;
+        const auto& rbox = m_nodes[node.right].box;
+        auto l = std::make_pair(node.left, slab(lbox, origin, inv, tmax));
+        auto r = std::make_pair(node.right, slab(rbox, origin, inv, tmax));
+        // visit the nearer child first
+        if (l.second < r.second) {
+          std::swap(l, r);
+        }
+        stack.push_back(l);
+        stack.push_back(r);
+      }
+    }
+    return best;
+  }
+
+  auto BVH::nearest(const vec_t&                      point,
+                    const std::vector<unsigned char>& skip) const -> Hit {
+    auto best      = npos;
+    auto best_dist = std::numeric_limits<float>::infinity();
+    if (m_nodes.empty()) {
+      return { best, best_dist };
+    }
+    std::vector<std::pair<unsigned int, float>> stack {
+      { 0, distance2(m_nodes[0].box, point) }
+    };
+    while (!stack.empty()) {
+      const auto [n, d] = stack.back();
+      stack.pop_back();
+      if (d > best_dist) {
+        continue;
+      }
+      const auto& node = m_nodes[n];
+      if (node.count > 0) {
+        for (auto i = node.first; i < node.first + node.count; ++i) {
+          if (!skip.empty() && skip[m_order[i]]) {
+            continue;
+          }
+          const auto dp = distance2(m_boxes[m_order[i]], point);
+          if (dp < best_dist) {
+            best      = m_order[i];
+            best_dist = dp;
+          }
+        }
+      } else {
+        auto l = std::make_pair(node.left,
+                                distance2(m_nodes[node.left].box, point));
+        auto r = std::make_pair(node.right,
+                                distance2(m_nodes[node.right].box, point));
+        if (l.second < r.second) {
+          std::swap(l, r);
+        }
+        stack.push_back(l);
+        stack.push_back(r);
+      }
+    }
+    return { best, std::sqrt(best_dist) };
+  }
+
+  void BVH::print() const {
+    printf("primitives [%ld] : nodes [%ld] : sah cost %.2f (built %.2f)",
+           m_boxes.size(),
+           m_nodes.size(),
+           cost(),
+           m_build_cost);
+  }
+
+} // namespace api::bvh
@@ -0,0 +1,98 @@
+#ifndef API_BVH_H
+#define API_BVH_H
+
+#include "global.h"
+
+#include "api/bounds.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace api::bvh {
+  using namespace api::bounds;
+
+  static constexpr unsigned int npos { static_cast<unsigned int>(-1) };
+  // primitives per leaf before the builder tries to split
+  static constexpr unsigned int MaxLeafSize { 4 };
+  static constexpr unsigned int SahBins { 16 };
+
+  struct Hit {
+    unsigned int primitive { npos };
+    float        t { 0.0f };
+  };
+
+  /*
+   * binary aabb hierarchy over a fixed set of primitives, built top-down
+   * with a binned surface area heuristic; moving primitives are handled by
+   * update + refit, which keeps the topology and only regrows the boxes
+   */
+  class BVH {
+    struct Node {
+      AABB         box;
+      unsigned int parent;
+      // interior : child indices; leaf : range in m_order (count > 0)
+      unsigned int left;
+      unsigned int right;
+      unsigned int first;
+      unsigned int count;
+    };
+
+    std::vector<Node>         m_nodes;
+    std::vector<AABB>         m_boxes;
+    std::vector<unsigned int> m_order;
+    std::vector<unsigned int> m_leaf_of;
+    float                     m_build_cost { 0.0f };
+    // set by update and refit, cleared once degraded has looked at it
+    bool                      m_moved { false };
+
+    auto subdivide(unsigned int, unsigned int, unsigned int) -> unsigned int;
+    void enclose(Node&) const;
+
+  public:
+    void build(const std::vector<AABB>&);
+    // rebuilds the topology around the current primitive boxes
+    void rebuild();
+    void clear();
+
+    // moves one primitive and regrows the boxes on its path to the root
+    void update(unsigned int, const AABB&);
+    void refit();
+
+    // sah cost relative to the root; grows as refits loosen the tree
+    [[nodiscard]]
+    auto cost() const -> float;
+    // only walks the tree when something moved since the last call
+    [[nodiscard]]
+    auto degraded() -> bool;
+
+    // per primitive : Outside, Intersect or Inside
+    void cull(const Frustum&, std::vector<unsigned char>&) const;
+    // closest primitive box along the ray, up to a maximum distance;
+    // primitives flagged in `skip` (if not empty) are ignored
+    [[nodiscard]]
+    auto raycast(const vec_t&,
+                 const vec_t&,
+                 float,
+                 const std::vector<unsigned char>& skip = {}) const -> Hit;
+    // primitive whose box is closest to a point, t is the distance
+    [[nodiscard]]
+    auto nearest(const vec_t&,
+                 const std::vector<unsigned char>& skip = {}) const -> Hit;
+
+    // accessors
+    [[nodiscard]]
+    auto size() const -> std::size_t {
+      return m_boxes.size();
+    }
+
+    [[nodiscard]]
+    auto box(unsigned int p) const -> const AABB& {
+      return m_boxes[p];
+    }
+
+    void print() const;
+  };
+
+} // namespace api::bvh
+
+#endif // API_BVH_H
@@ -0,0 +1,174 @@
+#include "cache.h"
+
+#include "utils/error.h"
+#include "utils/hash.h"
+#include "utils/log.h"
+
+#include <glad/gl.h>
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
+#include <fstream>
+#include <system_error>
+#include <vector>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+  #define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+  #define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+  #define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace api::cache {
+  using namespace utils;
+
+  namespace {
+    // "EPRG"
+    constexpr std::uint32_t Magic { 0x47525045 };
+
+    struct Entry {
+      std::uint32_t magic;
+      std::uint32_t format;
+      // full key, file names could collide after truncation or renaming
+      std::uint64_t key;
+      std::uint64_t length;
+    };
+
+    auto driverString(GLenum name) -> std::string {
+      const auto* s = glGetString(name);
+      return s == nullptr ? "" : reinterpret_cast<const char*>(s);
+    }
+  } // namespace
+
+  ProgramCache::ProgramCache(const std::filesystem::path& dir)
+    : m_dir { dir } {
+    m_driver = hash::fnv1a(driverString(GL_VENDOR));
+    m_driver = hash::fnv1a(driverString(GL_RENDERER), m_driver);
+    m_driver = hash::fnv1a(driverString(GL_VERSION), m_driver);
+
+    m_get_program_binary = reinterpret_cast<GetProgramBinary>(
+      glfwGetProcAddress("glGetProgramBinary"));
+    m_program_binary     = reinterpret_cast<ProgramBinary>(
+      glfwGetProcAddress("glProgramBinary"));
+    m_program_parameteri = reinterpret_cast<ProgramParameteri>(
+      glfwGetProcAddress("glProgramParameteri"));
+    auto formats         = 0;
+    if (m_get_program_binary != nullptr && m_program_binary != nullptr &&
+        m_program_parameteri != nullptr) {
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    // a driver may expose the entry points without any binary format
+    m_supported = formats > 0;
+    if (!m_supported) {
+      log::log(log::INFO, "program binaries unsupported, cache disabled");
+      return;
+    }
+    std::error_code error;
+    std::filesystem::create_directories(m_dir, error);
+    if (error) {
+      log::log(log::WARNING,
+               "cannot create program cache " + m_dir.generic_string() +
+                 " : " + error.message());
+      m_supported = false;
+    }
+  }
+
+  auto ProgramCache::entry(std::uint64_t key) const -> std::filesystem::path {
+    return m_dir / (hash::hex(key) + ".bin");
+  }
+
+  auto ProgramCache::key(std::uint64_t vertex, std::uint64_t fragment) const
+    -> std::uint64_t {
+    const std::uint64_t sources[] = { vertex, fragment };
+    return hash::fnv1a(sources, sizeof(sources), m_driver);
+  }
+
+  auto ProgramCache::load(unsigned int program, std::uint64_t key) const
+    -> bool {
+    if (!m_supported) {
+      return false;
+    }
+    const auto    path = entry(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+      ++m_misses;
+      return false;
+    }
+    // a truncated or corrupt length must not turn into a huge allocation
+    std::error_code error;
+    const auto      size = std::filesystem::file_size(path, error);
+    Entry           header {};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    std::vector<char> binary;
+    if (file && !error && header.magic == Magic && header.key == key &&
+        header.length == size - sizeof(header)) {
+      binary.resize(static_cast<std::size_t>(header.length));
+      file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    }
+    auto linked = 0;
+    if (file && !binary.empty()) {
+      m_program_binary(program,
+                       header.format,
+                       binary.data(),
+                       static_cast<int>(binary.size()));
+      glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    }
+    file.close();
+    if (!linked) {
+      log::log(log::DEBUG,
+               "discarding stale program binary " + path.generic_string());
+      std::filesystem::remove(path, error);
+      ++m_misses;
+      return false;
+    }
+    ++m_hits;
+    return true;
+  }
+
+  void ProgramCache::prepare(unsigned int program) const {
+    if (m_supported) {
+      m_program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, 1);
+    }
+  }
+
+  void ProgramCache::store(unsigned int program, std::uint64_t key) const {
+    if (!m_supported) {
+      return;
+    }
+    auto length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+      return;
+    }
+    std::vector<char> binary(static_cast<std::size_t>(length));
+    auto              format = 0u;
+    m_get_program_binary(program, length, &length, &format, binary.data());
+
+    const auto   header = Entry { Magic,
+                                  format,
+                                  key,
+                                  static_cast<std::uint64_t>(length) };
+    // written aside and renamed, a crash never leaves a truncated entry
+    const auto   path   = entry(key);
+    auto         temp   = path;
+    temp               += ".tmp";
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+    file.close();
+    std::error_code error;
+    if (file) {
+      std::filesystem::rename(temp, path, error);
+    }
+    if (!file || error) {
+      std::filesystem::remove(temp, error);
+      log::log(log::WARNING,
+               "failed to write program binary " + path.generic_string());
+    }
+  }
+
+} // namespace api::cache
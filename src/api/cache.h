@@ -0,0 +1,81 @@
+#ifndef API_CACHE_H
+#define API_CACHE_H
+
+#include <glad/gl.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+namespace api::cache {
+
+  /*
+   * on-disk cache of linked program binaries (glGetProgramBinary); entries
+   * are keyed by the final vertex and fragment source together with the
+   * driver vendor, renderer and version strings, so a driver update or any
+   * change to a substitution simply misses. a binary the driver refuses is
+   * deleted and the program is compiled from source as usual
+   *
+   * the entry points are core in 4.1 only and are resolved at runtime; on
+   * drivers without binary formats the cache stays inert
+   */
+  class ProgramCache {
+  public:
+    using GetProgramBinary =
+      void(GLAD_API_PTR*)(unsigned int, int, int*, unsigned int*, void*);
+    using ProgramBinary =
+      void(GLAD_API_PTR*)(unsigned int, unsigned int, const void*, int);
+    using ProgramParameteri = void(GLAD_API_PTR*)(unsigned int,
+                                                  unsigned int,
+                                                  int);
+
+  private:
+    std::filesystem::path m_dir;
+    // hash of the driver strings, seeds every key
+    std::uint64_t         m_driver { 0 };
+    bool                  m_supported { false };
+
+    GetProgramBinary  m_get_program_binary { nullptr };
+    ProgramBinary     m_program_binary { nullptr };
+    ProgramParameteri m_program_parameteri { nullptr };
+
+    mutable unsigned int m_hits { 0 };
+    mutable unsigned int m_misses { 0 };
+
+    auto entry(std::uint64_t) const -> std::filesystem::path;
+
+  public:
+    // needs a current context
+    explicit ProgramCache(const std::filesystem::path&);
+
+    // from the content hashes of the final sources
+    [[nodiscard]]
+    auto key(std::uint64_t vertex, std::uint64_t fragment) const
+      -> std::uint64_t;
+
+    // program is linked on success; a stale entry is removed on failure
+    auto load(unsigned int program, std::uint64_t key) const -> bool;
+    // must precede linking for the binary to be retrievable
+    void prepare(unsigned int program) const;
+    void store(unsigned int program, std::uint64_t key) const;
+
+    // accessors
+    [[nodiscard]]
+    auto supported() const -> bool {
+      return m_supported;
+    }
+
+    [[nodiscard]]
+    auto hits() const -> unsigned int {
+      return m_hits;
+    }
+
+    [[nodiscard]]
+    auto misses() const -> unsigned int {
+      return m_misses;
+    }
+  };
+
+} // namespace api::cache
+
+#endif // API_CACHE_H
@@ -12,7 +12,7 @@
 namespace api::camera {
   using namespace utils;
 
-  void Camera::set(const std::string& key, std::any value) {
+  void Camera::assign(const std::string& key, std::any value) {
     if (key == "type") {
       m_type = std::any_cast<CameraType>(value);
     } else if (key == "position") {
@@ -89,6 +89,7 @@ namespace api::camera {
     const auto front = glm::normalize(target - m_position);
     m_yaw            = glm::degrees(atan2(front.z, front.x));
     m_pitch          = glm::degrees(asin(front.y));
+    touch();
   }
 
   auto Camera::view() const -> transform_t {
@@ -105,6 +106,13 @@ namespace api::camera {
     }
   }
 
+  // fields are packed in the order of the Camera block in the vertex shader
+  void Camera::pack(Std140& block) const {
+    block.push(position());
+    block.push(view());
+    block.push(project());
+  }
+
   void Camera::print() const {
     printf("%s : pos [%.2f %.2f %.2f] : fwd [%.2f %.2f %.2f] : fov %.2f : "
            "[%.2f - %.2f]",
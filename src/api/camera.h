@@ -4,6 +4,7 @@
 #include "global.h"
 
 #include "api/object.h"
+#include "api/uniform.h"
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -12,6 +13,7 @@
 
 namespace api::camera {
   using namespace api::object;
+  using namespace api::uniform;
 
   enum class CameraType {
     Perspective,
@@ -43,8 +45,9 @@ namespace api::camera {
     static void mouseInputCallback(GLFWwindow*, double, double);
 
     void processKeyboardInput(GLFWwindow*, float);
+    void pack(Std140&) const;
     void print() const;
-    void set(const std::string&, std::any);
+    void assign(const std::string&, std::any) override;
 
     void toggleType() {
       set("type",
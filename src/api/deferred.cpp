@@ -0,0 +1,349 @@
+#include "deferred.h"
+
+#include "api/uniform.h"
+#include "utils/error.h"
+
+#include <glad/gl.h>
+
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace api::deferred {
+  using namespace utils;
+  using namespace api::uniform;
+
+  namespace {
+    struct Format {
+      GLint  internal;
+      GLenum format;
+      GLenum type;
+    };
+
+    // indexed by Target
+    constexpr Format Formats[] = {
+      // position, w : shininess
+      { GL_RGBA32F, GL_RGBA, GL_FLOAT },
+      // normal, w : 1 for unlit surfaces
+      { GL_RGBA16F, GL_RGBA, GL_FLOAT },
+      { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+      { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+      // sum of the lights before tone mapping
+      { GL_RGBA16F, GL_RGBA, GL_FLOAT },
+      { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT },
+    };
+
+    const char* const Samplers[] = {
+      "gPosition", "gNormal", "gAlbedo", "gSpecular", "accumulation", "depth",
+    };
+
+    constexpr float Zero[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    constexpr float Far    = 1.0f;
+
+    constexpr unsigned int Slices { 16 };
+    constexpr unsigned int Stacks { 8 };
+
+    // unit sphere, counter-clockwise seen from outside; vertices are
+    // pushed out so the flat faces never cut into the true sphere
+    void sphere(std::vector<float>& vertices,
+                std::vector<unsigned int>& indices) {
+      const auto pi    = glm::pi<float>();
+      const auto scale = 1.0f / (std::cos(pi / Slices) *
+                                 std::cos(pi / (2.0f * Stacks)));
+      for (auto i = 0u; i <= Stacks; ++i) {
+        const auto theta = pi * static_cast<float>(i) / Stacks;
+        for (auto j = 0u; j <= Slices; ++j) {
+          const auto phi = 2.0f * pi * static_cast<float>(j) / Slices;
+          vertices.push_back(scale * std::sin(theta) * std::cos(phi));
+          vertices.push_back(scale * std::cos(theta));
+          vertices.push_back(scale * std::sin(theta) * std::sin(phi));
+        }
+      }
+      for (auto i = 0u; i < Stacks; ++i) {
+        for (auto j = 0u; j < Slices; ++j) {
+          const auto a = i * (Slices + 1) + j;
+          const auto b = a + Slices + 1;
+          indices.insert(indices.end(), { a, b + 1, b, a, a + 1, b + 1 });
+        }
+      }
+    }
+  } // namespace
+
+  Renderer::Renderer(const std::filesystem::path& shader_path) {
+    m_base.readShadersFromPaths(
+      (shader_path / m_base.label()).generic_string() + ".vert.in",
+      (shader_path / m_base.label()).generic_string() + ".frag.in");
+
+    glGenTextures(Targets, m_textures);
+    for (auto t = 0u; t < Targets; ++t) {
+      glBindTexture(GL_TEXTURE_2D, m_textures[t]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // the lighting target shares the depth of the g-buffer
+    glGenFramebuffers(1, &m_gbuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_gbuffer);
+    {
+      for (auto t = 0u; t < Accumulation; ++t) {
+        glFramebufferTexture2D(GL_FRAMEBUFFER,
+                               GL_COLOR_ATTACHMENT0 + t,
+                               GL_TEXTURE_2D,
+                               m_textures[t],
+                               0);
+      }
+      glFramebufferTexture2D(GL_FRAMEBUFFER,
+                             GL_DEPTH_ATTACHMENT,
+                             GL_TEXTURE_2D,
+                             m_textures[Depth],
+                             0);
+      constexpr GLenum Attachments[] = { GL_COLOR_ATTACHMENT0,
+                                         GL_COLOR_ATTACHMENT1,
+                                         GL_COLOR_ATTACHMENT2,
+                                         GL_COLOR_ATTACHMENT3 };
+      glDrawBuffers(Accumulation, Attachments);
+    }
+    glGenFramebuffers(1, &m_lighting);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_lighting);
+    {
+      glFramebufferTexture2D(GL_FRAMEBUFFER,
+                             GL_COLOR_ATTACHMENT0,
+                             GL_TEXTURE_2D,
+                             m_textures[Accumulation],
+                             0);
+      glFramebufferTexture2D(GL_FRAMEBUFFER,
+                             GL_DEPTH_ATTACHMENT,
+                             GL_TEXTURE_2D,
+                             m_textures[Depth],
+                             0);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(1, &m_lights_vbo);
+    glGenVertexArrays(1, &m_screen_vao);
+    glGenVertexArrays(1, &m_distant_vao);
+    glGenVertexArrays(1, &m_unbounded_vao);
+    glGenVertexArrays(1, &m_sphere_vao);
+    glGenBuffers(1, &m_sphere_vbo);
+    glGenBuffers(1, &m_sphere_ebo);
+    std::vector<float>        vertices;
+    std::vector<unsigned int> indices;
+    sphere(vertices, indices);
+    m_sphere_indices = static_cast<unsigned int>(indices.size());
+    glBindVertexArray(m_sphere_vao);
+    {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_sphere_ebo);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                   indices.size() * sizeof(unsigned int),
+                   indices.data(),
+                   GL_STATIC_DRAW);
+      glBindBuffer(GL_ARRAY_BUFFER, m_sphere_vbo);
+      glBufferData(GL_ARRAY_BUFFER,
+                   vertices.size() * sizeof(float),
+                   vertices.data(),
+                   GL_STATIC_DRAW);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+      glEnableVertexAttribArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glBindVertexArray(0);
+  }
+
+  Renderer::~Renderer() {
+    glDeleteBuffers(1, &m_sphere_ebo);
+    glDeleteBuffers(1, &m_sphere_vbo);
+    glDeleteVertexArrays(1, &m_sphere_vao);
+    glDeleteVertexArrays(1, &m_unbounded_vao);
+    glDeleteVertexArrays(1, &m_distant_vao);
+    glDeleteVertexArrays(1, &m_screen_vao);
+    glDeleteBuffers(1, &m_lights_vbo);
+    glDeleteFramebuffers(1, &m_lighting);
+    glDeleteFramebuffers(1, &m_gbuffer);
+    glDeleteTextures(Targets, m_textures);
+  }
+
+  void Renderer::build(preprocess::Preprocessor&  preprocessor,
+                       const cache::ProgramCache* cache) {
+    m_passes = std::make_unique<permutation::Permutations>(m_base,
+                                                           preprocessor);
+    m_emissive   = &m_passes->build({ "EMISSIVE" }, cache);
+    m_distant    = &m_passes->build({ "DISTANT" }, cache);
+    m_positional = &m_passes->build({ "POSITIONAL" }, cache);
+    m_unbounded  = &m_passes->build({ "UNBOUNDED" }, cache);
+    m_resolve    = &m_passes->build({ "RESOLVE" }, cache);
+    for (const auto* pass :
+         { m_emissive, m_distant, m_positional, m_unbounded, m_resolve }) {
+      pass->bindUniformBlock("Camera", CameraBinding);
+      pass->use();
+      for (auto t = 0u; t < Targets; ++t) {
+        pass->setUniform1i(Samplers[t], static_cast<int>(t));
+      }
+    }
+    glUseProgram(0);
+  }
+
+  void Renderer::resize(int width, int height) {
+    m_width  = width;
+    m_height = height;
+    for (auto t = 0u; t < Targets; ++t) {
+      glBindTexture(GL_TEXTURE_2D, m_textures[t]);
+      glTexImage2D(GL_TEXTURE_2D,
+                   0,
+                   Formats[t].internal,
+                   width,
+                   height,
+                   0,
+                   Formats[t].format,
+                   Formats[t].type,
+                   nullptr);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    for (const auto fbo : { m_gbuffer, m_lighting }) {
+      glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+      if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+          GL_FRAMEBUFFER_COMPLETE) {
+        raise::error("incomplete g-buffer at " + std::to_string(width) +
+                     "x" + std::to_string(height));
+      }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
+
+  // PackedLight texels at locations 1..6, one light per instance
+  void Renderer::lightAttributes(unsigned int vao, std::size_t first) const {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_lights_vbo);
+    for (auto c = 0u; c < 6; ++c) {
+      glVertexAttribPointer(1 + c,
+                            4,
+                            GL_FLOAT,
+                            GL_FALSE,
+                            sizeof(light::PackedLight),
+                            (void*)(first * sizeof(light::PackedLight) +
+                                    c * sizeof(glm::vec4)));
+      glEnableVertexAttribArray(1 + c);
+      glVertexAttribDivisor(1 + c, 1);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+  }
+
+  void Renderer::upload(const std::vector<light::PackedLight>& lights,
+                        unsigned int                           distant) {
+    // a sphere of infinite radius has no finite vertices : such lights
+    // go fullscreen, right after the distant ones
+    m_ordered.assign(lights.begin(), lights.begin() + distant);
+    for (auto l = std::size_t { distant }; l < lights.size(); ++l) {
+      if (lights[l].position.w == light::Unbounded) {
+        m_ordered.push_back(lights[l]);
+      }
+    }
+    const auto unbounded = m_ordered.size() - distant;
+    for (auto l = std::size_t { distant }; l < lights.size(); ++l) {
+      if (lights[l].position.w != light::Unbounded) {
+        m_ordered.push_back(lights[l]);
+      }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, m_lights_vbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 m_ordered.size() * sizeof(light::PackedLight),
+                 m_ordered.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_distant_lights    = distant;
+    m_unbounded_lights  = static_cast<unsigned int>(unbounded);
+    m_positional_lights = static_cast<unsigned int>(lights.size()) - distant -
+                          m_unbounded_lights;
+    lightAttributes(m_distant_vao, 0);
+    lightAttributes(m_unbounded_vao, distant);
+    lightAttributes(m_sphere_vao, distant + unbounded);
+  }
+
+  auto Renderer::begin(int width, int height) -> bool {
+    // a minimized window : zero-sized attachments are incomplete
+    if (width <= 0 || height <= 0) {
+      return false;
+    }
+    if (width != m_width || height != m_height) {
+      resize(width, height);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_gbuffer);
+    for (auto t = 0; t < static_cast<int>(Accumulation); ++t) {
+      glClearBufferfv(GL_COLOR, t, Zero);
+    }
+    glClearBufferfv(GL_DEPTH, 0, &Far);
+    return true;
+  }
+
+  void Renderer::shade() {
+    if (m_resolve == nullptr) {
+      raise::error("deferred passes not built");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_lighting);
+    glClearBufferfv(GL_COLOR, 0, Zero);
+    for (auto t = 0u; t < Targets; ++t) {
+      glActiveTexture(GL_TEXTURE0 + t);
+      glBindTexture(GL_TEXTURE_2D, m_textures[t]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glDepthMask(GL_FALSE);
+
+    // fullscreen : emissive surfaces, every distant light, then the point
+    // and spot lights that reach everywhere
+    glDisable(GL_DEPTH_TEST);
+    m_emissive->use();
+    glBindVertexArray(m_screen_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    if (m_distant_lights > 0) {
+      m_distant->use();
+      glBindVertexArray(m_distant_vao);
+      glDrawArraysInstanced(GL_TRIANGLES, 0, 3, m_distant_lights);
+    }
+    if (m_unbounded_lights > 0) {
+      m_unbounded->use();
+      glBindVertexArray(m_unbounded_vao);
+      glDrawArraysInstanced(GL_TRIANGLES, 0, 3, m_unbounded_lights);
+    }
+
+    // volumes : pixels whose surface lies in front of the sphere's far side
+    if (m_positional_lights > 0) {
+      glEnable(GL_DEPTH_TEST);
+      glEnable(GL_DEPTH_CLAMP);
+      glDepthFunc(GL_GEQUAL);
+      glEnable(GL_CULL_FACE);
+      glCullFace(GL_FRONT);
+      m_positional->use();
+      glBindVertexArray(m_sphere_vao);
+      glDrawElementsInstanced(GL_TRIANGLES,
+                              m_sphere_indices,
+                              GL_UNSIGNED_INT,
+                              0,
+                              m_positional_lights);
+      glCullFace(GL_BACK);
+      glDisable(GL_CULL_FACE);
+      glDisable(GL_DEPTH_CLAMP);
+    }
+    glDisable(GL_BLEND);
+
+    // tone mapped into the default framebuffer, with the scene's depth so
+    // anything drawn afterwards is still hidden correctly
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_ALWAYS);
+    glDepthMask(GL_TRUE);
+    m_resolve->use();
+    glBindVertexArray(m_screen_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glDepthFunc(GL_LESS);
+    glBindVertexArray(0);
+  }
+
+} // namespace api::deferred
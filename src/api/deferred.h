@@ -0,0 +1,103 @@
+#ifndef API_DEFERRED_H
+#define API_DEFERRED_H
+
+#include "global.h"
+
+#include "api/cache.h"
+#include "api/light.h"
+#include "api/permutation.h"
+#include "api/preprocess.h"
+#include "api/shader.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace api::deferred {
+  using namespace api::shader;
+
+  /*
+   * deferred shading : the material variants, built with Define, write
+   * surface attributes to a g-buffer instead of lighting them. lights then
+   * add their share into an hdr accumulation target, distant ones over the
+   * whole screen, point and spot lights over the pixels covered by their
+   * sphere of influence (back faces with the depth test reversed, so the
+   * camera may sit inside one, and depth clamped, so the far plane never
+   * cuts one open), all of them in one instanced draw per kind; point
+   * and spot lights without a finite radius are shaded over the whole
+   * screen like distant ones. a last pass tone maps the sum into the
+   * default framebuffer and restores the depth there. shading cost follows
+   * the lit pixels instead of the geometry drawn
+   */
+  class Renderer {
+  public:
+    // variant define of the material programs writing the g-buffer
+    static constexpr const char* Define { "DEFERRED" };
+
+  private:
+    enum Target : unsigned int {
+      Position,
+      Normal,
+      Albedo,
+      Specular,
+      Accumulation,
+      Depth,
+      Targets
+    };
+
+    // passes, variants of deferred.vert.in and deferred.frag.in
+    ShaderProgram                              m_base { "deferred" };
+    std::unique_ptr<permutation::Permutations> m_passes;
+    ShaderProgram*                             m_emissive { nullptr };
+    ShaderProgram*                             m_distant { nullptr };
+    ShaderProgram*                             m_positional { nullptr };
+    ShaderProgram*                             m_unbounded { nullptr };
+    ShaderProgram*                             m_resolve { nullptr };
+
+    unsigned int m_textures[Targets];
+    unsigned int m_gbuffer;
+    unsigned int m_lighting;
+    int          m_width { 0 };
+    int          m_height { 0 };
+
+    // light volume : unit sphere, refined enough to circumscribe it
+    unsigned int m_sphere_vao;
+    unsigned int m_sphere_vbo;
+    unsigned int m_sphere_ebo;
+    unsigned int m_sphere_indices { 0 };
+    // fullscreen triangles : without, and with per-light attributes
+    unsigned int m_screen_vao;
+    unsigned int m_distant_vao;
+    unsigned int m_unbounded_vao;
+    // light::PackedLight per light : distant, unbounded, then the others
+    unsigned int                    m_lights_vbo;
+    std::vector<light::PackedLight> m_ordered;
+    unsigned int                    m_distant_lights { 0 };
+    unsigned int                    m_unbounded_lights { 0 };
+    unsigned int                    m_positional_lights { 0 };
+
+    void resize(int, int);
+    void lightAttributes(unsigned int vao, std::size_t first) const;
+
+  public:
+    // reads the pass shaders from the directory; needs a current context
+    explicit Renderer(const std::filesystem::path&);
+    ~Renderer();
+
+    Renderer(const Renderer&) = delete;
+
+    void build(preprocess::Preprocessor&, const cache::ProgramCache*);
+    // whenever any light changed
+    void upload(const std::vector<light::PackedLight>&, unsigned int distant);
+
+    // material programs draw into the g-buffer between begin and shade;
+    // false for an empty framebuffer, with nothing to draw or shade
+    [[nodiscard]]
+    auto begin(int width, int height) -> bool;
+    void shade();
+  };
+
+} // namespace api::deferred
+
+#endif // API_DEFERRED_H
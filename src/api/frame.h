@@ -0,0 +1,94 @@
+#ifndef API_FRAME_H
+#define API_FRAME_H
+
+#include "global.h"
+
+#include "api/light.h"
+#include "api/uniform.h"
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace api::frame {
+  using namespace api::uniform;
+
+  /*
+   * everything the render thread needs to draw one frame, captured by the
+   * simulation thread; never modified once published
+   */
+  struct FramePacket {
+    // increasing per published packet, 0 : never filled
+    unsigned long serial { 0 };
+    float         time { 0.0f };
+    int           width { 0 };
+    int           height { 0 };
+
+    // camera : std140 block plus what culling needs
+    unsigned long camera_version { 0 };
+    Std140        camera;
+    transform_t   view_projection { 1.0f };
+    pos_t         eye { 0.0f };
+    float         znear { 0.1f };
+    float         zfar { 1.0f };
+    // pixels covered by one world unit at distance 1, 0 : no lod
+    float         lod_scale { 0.0f };
+
+    // lights : std140 structs in declaration order; light l occupies
+    // [light_offsets[l], light_offsets[l + 1]) of the block
+    std::vector<unsigned long> light_versions;
+    std::vector<std::size_t>   light_offsets;
+    Std140                     lights;
+    // the same lights for the tiled and deferred paths, which fill these
+    // instead : the distant ones first, then every other; versions follow
+    // this order
+    std::vector<light::PackedLight> packed_lights;
+    unsigned int                    distant_lights { 0 };
+
+    // transform store state, indexed by node handle
+    std::vector<transform_t>   world;
+    std::vector<glm::mat3>     normal;
+    std::vector<unsigned long> revision;
+  };
+
+  /*
+   * single producer, single consumer triple buffer : the producer fills
+   * back() and publishes it, the consumer picks up the latest published
+   * slot; neither side ever blocks, stale slots are simply overwritten
+   */
+  template <typename T>
+  class TripleBuffer {
+    static constexpr unsigned int Index { 3 };
+    static constexpr unsigned int Fresh { 4 };
+
+    T                         m_slots[3];
+    unsigned int              m_back { 0 };
+    unsigned int              m_front { 1 };
+    // slot between the two sides, tagged Fresh once published
+    std::atomic<unsigned int> m_middle { 2 };
+
+  public:
+    [[nodiscard]]
+    auto back() -> T& {
+      return m_slots[m_back];
+    }
+
+    void publish() {
+      m_back = m_middle.exchange(m_back | Fresh, std::memory_order_acq_rel) &
+               Index;
+    }
+
+    // latest published slot, or the previous one if nothing new arrived
+    [[nodiscard]]
+    auto acquire() -> const T& {
+      if (m_middle.load(std::memory_order_relaxed) & Fresh) {
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) &
+                  Index;
+      }
+      return m_slots[m_front];
+    }
+  };
+
+} // namespace api::frame
+
+#endif // API_FRAME_H
@@ -0,0 +1,163 @@
+#include "geometry.h"
+
+#include "utils/error.h"
+#include "utils/log.h"
+#include "utils/meshopt.h"
+
+#include <cstdio>
+#include <string>
+#include <utility>
+
+namespace api::geometry {
+  using namespace utils;
+
+  namespace {
+    unsigned int GeometryId { 0 };
+  } // namespace
+
+  Geometry::Geometry(const std::string&               name,
+                     const std::vector<float>&        vertices,
+                     const std::vector<unsigned int>& indices,
+                     const std::vector<float>&        uvCoords)
+    : m_id { GeometryId++ }
+    , m_name { name }
+    , m_vertices { vertices }
+    , m_indices { indices }
+    , m_uvCoords { uvCoords }
+    , m_aabb { bounds::aabb(vertices) }
+    , m_sphere { bounds::sphere(vertices) } {}
+
+  Geometry::Geometry(
+    const std::string&                                      name,
+    const std::shared_ptr<const utils::mapped::MappedFile>& mapping,
+    utils::mapped::View<float>                              vertices,
+    utils::mapped::View<unsigned int>                       indices,
+    const std::vector<Lod>&                                 lods,
+    const bounds::AABB&                                     aabb,
+    const bounds::Sphere&                                   sphere)
+    : m_id { GeometryId++ }
+    , m_name { name }
+    , m_aabb { aabb }
+    , m_sphere { sphere }
+    , m_gpu_vertices { vertices }
+    , m_gpu_indices { indices }
+    , m_mapping { mapping }
+    , m_lods { lods }
+    , m_buffers_generated { true } {}
+
+  void Geometry::regenBuffers() {
+    if (m_mapping != nullptr) {
+      raise::error("geometry loaded from a snapshot has no source: " + m_name);
+    }
+    // weld identical corners and reorder triangles for the vertex cache
+    auto       stream       = meshopt::weld(recalculate(), 8);
+    const auto nvertices    = stream.vertices.size() / 8;
+    const auto acmr_welded  = meshopt::acmr(stream.indices, nvertices);
+    meshopt::optimizeTriangleOrder(stream.indices, stream.vertices, 8);
+    meshopt::optimizeVertexFetch(stream, 8);
+    const auto acmr_optimal = meshopt::acmr(stream.indices, nvertices);
+    log::log(log::INFO,
+             m_name + " : " + std::to_string(m_indices.size()) + " -> " +
+               std::to_string(nvertices) + " vertices, acmr " +
+               std::to_string(acmr_welded) + " -> " +
+               std::to_string(acmr_optimal));
+    m_gpu          = std::move(stream);
+    m_lods         = { Lod { 0, m_gpu.indices.size(), 0.0f } };
+    m_gpu_vertices = m_gpu.vertices;
+    m_gpu_indices  = m_gpu.indices;
+    ++m_revision;
+    m_buffers_generated = true;
+  }
+
+  void Geometry::generateLods(unsigned int levels, float ratio) {
+    if (!m_buffers_generated) {
+      raise::error("buffers not generated for geometry: " + m_name);
+    }
+    if (m_mapping != nullptr) {
+      // new levels need writable streams : leave the mapping
+      m_gpu.vertices.assign(m_gpu_vertices.begin(), m_gpu_vertices.end());
+      m_gpu.indices.assign(m_gpu_indices.begin(), m_gpu_indices.end());
+      m_mapping.reset();
+    }
+    // start over from the full mesh
+    m_gpu.indices.resize(m_lods.front().count);
+    m_lods.resize(1);
+    std::vector<unsigned int> current = m_gpu.indices;
+    std::string               summary = std::to_string(current.size() / 3);
+    for (auto l = 1u; l < levels; ++l) {
+      const auto target =
+        static_cast<std::size_t>(current.size() / 3 * ratio) * 3;
+      auto error = 0.0f;
+      auto next =
+        meshopt::simplify(current, m_gpu.vertices, 8, target, &error);
+      if (next.empty() || next.size() >= current.size()) {
+        // every remaining vertex is locked by a seam or a border
+        break;
+      }
+      meshopt::optimizeTriangleOrder(next, m_gpu.vertices, 8);
+      // levels are simplified from each other : errors add up
+      m_lods.push_back(
+        Lod { m_gpu.indices.size(), next.size(), m_lods.back().error + error });
+      m_gpu.indices.insert(m_gpu.indices.end(), next.begin(), next.end());
+      summary += " -> " + std::to_string(next.size() / 3);
+      current  = std::move(next);
+    }
+    m_gpu_vertices = m_gpu.vertices;
+    m_gpu_indices  = m_gpu.indices;
+    log::log(log::INFO, m_name + " : lods " + summary + " triangles");
+    ++m_revision;
+  }
+
+  auto Geometry::recalculate() const -> std::vector<float> {
+    std::vector<float> vertices(m_indices.size() * 8, 0.0);
+    for (auto tidx = 0u; tidx < m_indices.size(); tidx += 3) {
+      const auto vidx1 = m_indices[tidx + 0] * 3;
+      const auto vidx2 = m_indices[tidx + 1] * 3;
+      const auto vidx3 = m_indices[tidx + 2] * 3;
+
+      const auto normal = vec_t(
+        -m_vertices[vidx2 + 2] * m_vertices[vidx3 + 1] +
+          m_vertices[vidx1 + 2] *
+            (-m_vertices[vidx2 + 1] + m_vertices[vidx3 + 1]) +
+          m_vertices[vidx1 + 1] *
+            (m_vertices[vidx2 + 2] - m_vertices[vidx3 + 2]) +
+          m_vertices[vidx2 + 1] * m_vertices[vidx3 + 2],
+        m_vertices[vidx1 + 2] *
+            (m_vertices[vidx2 + 0] - m_vertices[vidx3 + 0]) +
+          m_vertices[vidx2 + 2] * m_vertices[vidx3 + 0] -
+          m_vertices[vidx2 + 0] * m_vertices[vidx3 + 2] +
+          m_vertices[vidx1 + 0] *
+            (-m_vertices[vidx2 + 2] + m_vertices[vidx3 + 2]),
+        -m_vertices[vidx2 + 1] * m_vertices[vidx3 + 0] +
+          m_vertices[vidx1 + 1] *
+            (-m_vertices[vidx2 + 0] + m_vertices[vidx3 + 0]) +
+          m_vertices[vidx1 + 0] *
+            (m_vertices[vidx2 + 1] - m_vertices[vidx3 + 1]) +
+          m_vertices[vidx2 + 0] * m_vertices[vidx3 + 1]);
+      for (auto vidx = 0u; vidx < 3; vidx++) {
+        vertices[(tidx + vidx) * 8 + 0] =
+          m_vertices[m_indices[tidx + vidx] * 3 + 0];
+        vertices[(tidx + vidx) * 8 + 1] =
+          m_vertices[m_indices[tidx + vidx] * 3 + 1];
+        vertices[(tidx + vidx) * 8 + 2] =
+          m_vertices[m_indices[tidx + vidx] * 3 + 2];
+        vertices[(tidx + vidx) * 8 + 3] = normal.x;
+        vertices[(tidx + vidx) * 8 + 4] = normal.y;
+        vertices[(tidx + vidx) * 8 + 5] = normal.z;
+        vertices[(tidx + vidx) * 8 + 6] = m_uvCoords[(tidx + vidx) * 2 + 0];
+        vertices[(tidx + vidx) * 8 + 7] = m_uvCoords[(tidx + vidx) * 2 + 1];
+      }
+    }
+    return vertices;
+  }
+
+  void Geometry::print() const {
+    printf("%s%u : nvert [%ld] : nind [%ld] -- %s",
+           m_name.c_str(),
+           id(),
+           m_vertices.size(),
+           m_indices.size(),
+           m_buffers_generated ? "✓" : "✗");
+  }
+
+} // namespace api::geometry
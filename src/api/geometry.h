@@ -0,0 +1,162 @@
+#ifndef API_GEOMETRY_H
+#define API_GEOMETRY_H
+
+#include "global.h"
+
+#include "api/bounds.h"
+#include "api/prefabs.h"
+#include "utils/mapped.h"
+#include "utils/meshopt.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace api::geometry {
+
+  // per-instance attributes streamed from the scene instance buffer
+  struct Instance {
+    transform_t  model;
+    // normal matrix columns, padded to vec4
+    glm::vec4    normal[3];
+    unsigned int matIdx;
+    unsigned int padding[3];
+  };
+
+  // one level of detail : a slice of the gpu index stream
+  struct Lod {
+    std::size_t first;
+    std::size_t count;
+    // object-space deviation from level 0
+    float       error;
+  };
+
+  /*
+   * vertex data shared by any number of meshes;
+   * regenBuffers prepares the welded gpu-ready streams, which the scene
+   * uploads into its geometry arena; generateLods appends coarser index
+   * lists over the same vertices, all levels share one index stream.
+   * geometry loaded from a scene snapshot has no source data : its gpu
+   * streams point straight into the mapped file
+   */
+  class Geometry {
+    const unsigned int m_id;
+    const std::string  m_name;
+
+    std::vector<float>        m_vertices;
+    std::vector<unsigned int> m_indices;
+    std::vector<float>        m_uvCoords;
+
+    // local-space bounds of m_vertices
+    bounds::AABB   m_aabb;
+    bounds::Sphere m_sphere;
+
+    // welded, cache-optimized interleaved vertices and indices
+    utils::meshopt::IndexedStream m_gpu;
+    // what the accessors expose : m_gpu, or a range of m_mapping
+    utils::mapped::View<float>        m_gpu_vertices;
+    utils::mapped::View<unsigned int> m_gpu_indices;
+    std::shared_ptr<const utils::mapped::MappedFile> m_mapping;
+    // level 0 is the full mesh, each next level is coarser
+    std::vector<Lod>              m_lods;
+    // bumped whenever the gpu-ready streams are regenerated
+    unsigned int                  m_revision { 0 };
+
+    bool m_buffers_generated { false };
+
+    auto recalculate() const -> std::vector<float>;
+
+  public:
+    Geometry(const std::string&,
+             const std::vector<float>&,
+             const std::vector<unsigned int>&,
+             const std::vector<float>&);
+
+    Geometry(const std::string& name, const prefabs::Prefab& obj)
+      : Geometry { name, obj.vertices, obj.indices, obj.uvCoords } {}
+
+    // gpu-ready streams living in a mapped file, kept alive by the geometry
+    Geometry(const std::string&,
+             const std::shared_ptr<const utils::mapped::MappedFile>&,
+             utils::mapped::View<float>,
+             utils::mapped::View<unsigned int>,
+             const std::vector<Lod>&,
+             const bounds::AABB&,
+             const bounds::Sphere&);
+
+    Geometry(const Geometry&) = delete;
+
+    void regenBuffers();
+    // simplifies up to levels - 1 times, each level keeping `ratio` of
+    // the triangles of the previous one
+    void generateLods(unsigned int levels, float ratio = 0.5f);
+
+    // accessors
+    [[nodiscard]]
+    auto id() const -> unsigned int {
+      return m_id;
+    }
+
+    [[nodiscard]]
+    auto name() const -> const std::string& {
+      return m_name;
+    }
+
+    [[nodiscard]]
+    auto gpuVertices() const -> utils::mapped::View<float> {
+      return m_gpu_vertices;
+    }
+
+    // every level, concatenated
+    [[nodiscard]]
+    auto gpuIndices() const -> utils::mapped::View<unsigned int> {
+      return m_gpu_indices;
+    }
+
+    [[nodiscard]]
+    auto lods() const -> const std::vector<Lod>& {
+      return m_lods;
+    }
+
+    [[nodiscard]]
+    auto revision() const -> unsigned int {
+      return m_revision;
+    }
+
+    [[nodiscard]]
+    auto vertices() const -> const std::vector<float>& {
+      return m_vertices;
+    }
+
+    [[nodiscard]]
+    auto indices() const -> const std::vector<unsigned int>& {
+      return m_indices;
+    }
+
+    [[nodiscard]]
+    auto uvCoords() const -> const std::vector<float>& {
+      return m_uvCoords;
+    }
+
+    [[nodiscard]]
+    auto aabb() const -> const bounds::AABB& {
+      return m_aabb;
+    }
+
+    [[nodiscard]]
+    auto sphere() const -> const bounds::Sphere& {
+      return m_sphere;
+    }
+
+    [[nodiscard]]
+    auto buffersGenerated() const -> bool {
+      return m_buffers_generated;
+    }
+
+    void print() const;
+  };
+
+} // namespace api::geometry
+
+#endif // API_GEOMETRY_H
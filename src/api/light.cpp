@@ -1,16 +1,17 @@
 #include "light.h"
 
-#include "api/shader.h"
+#include "api/uniform.h"
 #include "utils/error.h"
 
 #include <algorithm>
 #include <any>
+#include <cmath>
 #include <cstdio>
 #include <string>
 
 namespace api::light {
   using namespace utils;
-  using namespace api::shader;
+  using namespace api::uniform;
 
   auto to_string(LightType type) -> std::string {
     switch (type) {
@@ -30,7 +31,7 @@ namespace api::light {
     printf("%sLight%u\n", to_string(m_type).c_str(), id());
   }
 
-  void LightSource::set(const std::string& key, std::any value) {
+  void LightSource::assign(const std::string& key, std::any value) {
     if (key == "ambientColor") {
       m_ambient_color = std::any_cast<color_t>(value);
     } else if (key == "diffuseColor") {
@@ -48,42 +49,54 @@ namespace api::light {
     }
   }
 
-  void LightSource::illuminate(const ShaderProgram& shader) const {
-    shader.setUniform3fv(uniformLabel("ambientColor"), ambientColor());
-    shader.setUniform3fv(uniformLabel("diffuseColor"), diffuseColor());
-    shader.setUniform3fv(uniformLabel("specularColor"), specularColor());
-    shader.setUniform1f(uniformLabel("ambientStrength"), ambientStrength());
-    shader.setUniform1f(uniformLabel("diffuseStrength"), diffuseStrength());
-    shader.setUniform1f(uniformLabel("specularStrength"), specularStrength());
+  // fields are packed in the order of the corresponding glsl struct
+  void LightSource::pack(Std140& block) const {
+    block.push(ambientColor());
+    block.push(diffuseColor());
+    block.push(specularColor());
+    block.push(ambientStrength());
+    block.push(diffuseStrength());
+    block.push(specularStrength());
+  }
+
+  void LightSource::pack(PackedLight& light) const {
+    light.ambient  = glm::vec4(ambientColor() * ambientStrength(), 0.0f);
+    light.diffuse  = glm::vec4(diffuseColor() * diffuseStrength(), 0.0f);
+    light.specular = glm::vec4(specularColor() * specularStrength(), 0.0f);
   }
 
   [[nodiscard]]
   auto LightSource::shaderDeclaration() const -> std::string {
     auto type = to_string(m_type);
     std::transform(type.begin(), type.begin() + 1, type.begin(), ::toupper);
-    return "uniform " + type + "Light " + label() + ";";
+    return type + "Light " + label() + ";";
   }
 
   [[nodiscard]]
   auto LightSource::shaderCall() const -> std::string {
     if (m_type == LightType::Point) {
       return "result += CalcPointLight(" + label() +
-             ", norm, FragPos, viewDir, defaultMaterial[activeMesh.matIdx]);";
+             ", norm, FragPos, viewDir, defaultMaterial[MatIdx]);";
     } else if (m_type == LightType::Distant) {
       return "result += CalcDistantLight(" + label() +
-             ", norm, viewDir, defaultMaterial[activeMesh.matIdx]);";
+             ", norm, viewDir, defaultMaterial[MatIdx]);";
     } else if (m_type == LightType::Spotlight) {
       return "result += CalcSpotLight(" + label() +
-             ", norm, FragPos, viewDir, defaultMaterial[activeMesh.matIdx]);";
+             ", norm, FragPos, viewDir, defaultMaterial[MatIdx]);";
     } else {
       raise::error("light type not recognized");
       return "";
     }
   }
 
-  void Positional::set(const std::string& key, std::any value) {
+  Positional::~Positional() {
+    transform::store().release(m_node);
+  }
+
+  void Positional::assign(const std::string& key, std::any value) {
     if (key == "position") {
       m_position = std::any_cast<pos_t>(value);
+      transform::store().setPosition(m_node, m_position);
     } else if (key == "constant") {
       m_constant = std::any_cast<float>(value);
     } else if (key == "linear") {
@@ -93,38 +106,68 @@ namespace api::light {
     } else if (key == "ambientColor" || key == "diffuseColor" ||
                key == "specularColor" || key == "ambientStrength" ||
                key == "diffuseStrength" || key == "specularStrength") {
-      LightSource::set(key, value);
+      LightSource::assign(key, value);
     } else {
       raise::error("invalid key for Positional " + key);
     }
   }
 
-  void Positional::illuminate(const ShaderProgram& shader) const {
-    LightSource::illuminate(shader);
-    shader.setUniform3fv(uniformLabel("position"), position());
-    shader.setUniform1f(uniformLabel("constant"), constant());
-    shader.setUniform1f(uniformLabel("linear"), linear());
-    shader.setUniform1f(uniformLabel("quadratic"), quadratic());
+  void Positional::pack(Std140& block) const {
+    block.push(position());
+    block.push(constant());
+    block.push(linear());
+    block.push(quadratic());
+    LightSource::pack(block);
+  }
+
+  void Positional::pack(PackedLight& light) const {
+    LightSource::pack(light);
+    light.position    = glm::vec4(position(), radius());
+    light.direction.w = constant();
+    light.ambient.w   = linear();
+    light.diffuse.w   = quadratic();
+  }
+
+  auto Positional::radius() const -> float {
+    const auto peak = ambientColor() * ambientStrength() +
+                      diffuseColor() * diffuseStrength() +
+                      specularColor() * specularStrength();
+    // solves constant + linear d + quadratic d^2 = brightest / Cutoff
+    const auto k = std::max({ peak.r, peak.g, peak.b }) / Cutoff - constant();
+    if (k <= 0.0f) {
+      return 0.0f;
+    }
+    if (quadratic() > 0.0f) {
+      return (-linear() +
+              std::sqrt(linear() * linear() + 4.0f * quadratic() * k)) /
+             (2.0f * quadratic());
+    }
+    return linear() > 0.0f ? k / linear() : Unbounded;
+  }
+
+  void Directional::pack(PackedLight& light) const {
+    LightSource::pack(light);
+    light.direction = glm::vec4(direction(), light.direction.w);
   }
 
-  void Directional::illuminate(const ShaderProgram& shader) const {
-    LightSource::illuminate(shader);
-    shader.setUniform3fv(uniformLabel("direction"), direction());
+  void Directional::pack(Std140& block) const {
+    block.push(direction());
+    LightSource::pack(block);
   }
 
-  void Directional::set(const std::string& key, std::any value) {
+  void Directional::assign(const std::string& key, std::any value) {
     if (key == "direction") {
       m_direction = std::any_cast<vec_t>(value);
     } else if (key == "ambientColor" || key == "diffuseColor" ||
                key == "specularColor" || key == "ambientStrength" ||
                key == "diffuseStrength" || key == "specularStrength") {
-      LightSource::set(key, value);
+      LightSource::assign(key, value);
     } else {
       raise::error("invalid key for Directional " + key);
     }
   }
 
-  void Spotlight::set(const std::string& key, std::any value) {
+  void Spotlight::assign(const std::string& key, std::any value) {
     if (key == "cutoff") {
       m_cutoff = std::any_cast<float>(value);
     } else if (key == "outerCutoff") {
@@ -132,24 +175,35 @@ namespace api::light {
     } else if (key == "ambientColor" || key == "diffuseColor" ||
                key == "specularColor" || key == "ambientStrength" ||
                key == "diffuseStrength" || key == "specularStrength") {
-      LightSource::set(key, value);
+      LightSource::assign(key, value);
     } else if (key == "position" || key == "constant" || key == "linear" ||
                key == "quadratic") {
-      Positional::set(key, value);
+      Positional::assign(key, value);
     } else if (key == "direction") {
-      Directional::set(key, value);
+      Directional::assign(key, value);
     } else {
       raise::error("invalid key for Spotlight " + key);
     }
   }
 
-  void Spotlight::illuminate(const ShaderProgram& shader) const {
-    Directional::illuminate(shader);
-    Positional::illuminate(shader);
-    shader.setUniform1f(uniformLabel("cutOff"),
-                        glm::cos(glm::radians(cutoff())));
-    shader.setUniform1f(uniformLabel("outerCutOff"),
-                        glm::cos(glm::radians(outerCutoff())));
+  void Spotlight::pack(PackedLight& light) const {
+    Positional::pack(light);
+    light.direction = glm::vec4(direction(), light.direction.w);
+    light.cone      = glm::vec4(glm::cos(glm::radians(cutoff())),
+                                glm::cos(glm::radians(outerCutoff())),
+                                0.0f,
+                                0.0f);
+  }
+
+  void Spotlight::pack(Std140& block) const {
+    block.push(position());
+    block.push(direction());
+    block.push(glm::cos(glm::radians(cutoff())));
+    block.push(glm::cos(glm::radians(outerCutoff())));
+    block.push(constant());
+    block.push(linear());
+    block.push(quadratic());
+    LightSource::pack(block);
   }
 
 } // namespace api::light
@@ -4,14 +4,18 @@
 #include "global.h"
 
 #include "api/object.h"
-#include "api/shader.h"
+#include "api/transform.h"
+#include "api/uniform.h"
+
+#include <glm/glm.hpp>
 
 #include <any>
+#include <limits>
 #include <string>
 
 namespace api::light {
-  using namespace api::shader;
   using namespace api::object;
+  using namespace api::uniform;
 
   enum class LightType {
     Distant,
@@ -21,7 +25,30 @@ namespace api::light {
 
   auto to_string(LightType type) -> std::string;
 
-  static unsigned int LightId { 0 };
+  inline unsigned int LightId { 0 };
+
+  // radius of a light whose attenuation never falls below Cutoff
+  constexpr float Unbounded { std::numeric_limits<float>::max() };
+
+  /*
+   * one light as the tiled path reads it from a texture buffer : six
+   * rgba32f texels, colors premultiplied by their strengths; member order
+   * must match fetchLight in tiled.glsl
+   */
+  struct PackedLight {
+    // xyz, w : radius of influence (0 for distant lights)
+    glm::vec4 position { 0.0f };
+    // xyz, w : constant attenuation
+    glm::vec4 direction { 0.0f, -1.0f, 0.0f, 1.0f };
+    // rgb, w : linear attenuation
+    glm::vec4 ambient { 0.0f };
+    // rgb, w : quadratic attenuation
+    glm::vec4 diffuse { 0.0f };
+    glm::vec4 specular { 0.0f };
+    // cosines of the inner and outer cone; the default is wider than a
+    // sphere, so point lights go through the spotlight code unchanged
+    glm::vec4 cone { -1.0f, -2.0f, 0.0f, 0.0f };
+  };
 
   class LightSource : public Object {
   protected:
@@ -39,8 +66,9 @@ namespace api::light {
   public:
     LightSource(LightType type) : m_id { LightId++ }, m_type { type } {}
 
-    virtual void illuminate(const ShaderProgram&) const;
-    virtual void set(const std::string& key, std::any value) override;
+    virtual void pack(Std140&) const;
+    virtual void pack(PackedLight&) const;
+    virtual void assign(const std::string& key, std::any value) override;
     void         print() const;
 
     // accessors
@@ -59,11 +87,6 @@ namespace api::light {
       return to_string(type()) + "Light" + std::to_string(id());
     }
 
-    [[nodiscard]]
-    auto uniformLabel(const std::string& uniform) const -> std::string {
-      return label() + "." + uniform;
-    }
-
     [[nodiscard]]
     auto ambientColor() const -> color_t {
       return m_ambient_color;
@@ -108,19 +131,35 @@ namespace api::light {
     float m_linear { 0.09f };
     float m_quadratic { 0.032f };
 
-  public:
-    pos_t* const position_ptr { &m_position };
+    // meshes marking the light are attached to this node
+    transform::handle_t m_node { transform::store().create() };
 
+  public:
     Positional(LightType type) : LightSource { type } {}
+    Positional(const Positional&) = delete;
+    ~Positional();
 
-    virtual void illuminate(const ShaderProgram&) const override;
-    virtual void set(const std::string&, std::any) override;
+    // attenuated contributions fall below this beyond radius()
+    static constexpr float Cutoff { 1.0f / 256.0f };
+
+    virtual void pack(Std140&) const override;
+    virtual void pack(PackedLight&) const override;
+    virtual void assign(const std::string&, std::any) override;
+
+    // distance past which the light adds less than Cutoff to any channel
+    [[nodiscard]]
+    auto radius() const -> float;
 
     [[nodiscard]]
     auto position() const -> pos_t {
       return m_position;
     }
 
+    [[nodiscard]]
+    auto node() const -> transform::handle_t {
+      return m_node;
+    }
+
     [[nodiscard]]
     auto constant() const -> float {
       return m_constant;
@@ -143,8 +182,9 @@ namespace api::light {
   public:
     Directional(LightType type) : LightSource { type } {}
 
-    virtual void illuminate(const ShaderProgram&) const override;
-    virtual void set(const std::string&, std::any) override;
+    virtual void pack(Std140&) const override;
+    virtual void pack(PackedLight&) const override;
+    virtual void assign(const std::string&, std::any) override;
 
     [[nodiscard]]
     auto direction() const -> vec_t {
@@ -183,8 +223,9 @@ namespace api::light {
       configure(params);
     }
 
-    void illuminate(const ShaderProgram&) const override;
-    void set(const std::string&, std::any) override;
+    void pack(Std140&) const override;
+    void pack(PackedLight&) const override;
+    void assign(const std::string&, std::any) override;
 
     [[nodiscard]]
     auto cutoff() const -> float {
@@ -3,6 +3,7 @@
 #include "api/shader.h"
 #include "utils/error.h"
 
+#include <algorithm>
 #include <any>
 #include <cstdio>
 #include <filesystem>
@@ -48,6 +49,12 @@ namespace api::material {
     }
   }
 
+  auto shaderDefine(MaterialType type) -> std::string {
+    auto define = "MATERIAL_" + to_string(type);
+    std::transform(define.begin(), define.end(), define.begin(), ::toupper);
+    return define;
+  }
+
   auto shaderDeclaration(unsigned int id, unsigned int N) -> std::string {
     auto shader_type = from_inShaderId(id);
     shader_type[0]   = std::toupper(shader_type[0]);
@@ -55,16 +62,11 @@ namespace api::material {
            "Material[" + std::to_string(N) + "];";
   }
 
-  void Material::shade(const ShaderProgram& shader) const {
-    shader.setUniform1ui("activeMesh.matId", inShaderId());
-    shader.setUniform1ui("activeMesh.matIdx", id());
-  }
-
   void Material::print() const {
     printf("%s", label().c_str());
   }
 
-  void Normal::set(const std::string& key, std::any value) {
+  void Normal::assign(const std::string& key, std::any value) {
     if (key == "shininess") {
       m_shininess = std::any_cast<float>(value);
     } else if (key == "diffuseTexture") {
@@ -78,20 +80,26 @@ namespace api::material {
     }
   }
 
-  void Normal::shade(const ShaderProgram& shader) const {
-    Material::shade(shader);
+  void Normal::bindTextures() const {
     if (diffuseTexture() != nullptr) {
-      shader.setUniform1i(uniformLabel("diffuseMap"), 0);
       diffuseTexture()->use(0);
     }
     if (specularTexture() != nullptr) {
-      shader.setUniform1i(uniformLabel("specularMap"), 1);
       specularTexture()->use(1);
     }
+  }
+
+  void Normal::upload(const ShaderProgram& shader) const {
+    if (diffuseTexture() != nullptr) {
+      shader.setUniform1i(uniformLabel("diffuseMap"), 0);
+    }
+    if (specularTexture() != nullptr) {
+      shader.setUniform1i(uniformLabel("specularMap"), 1);
+    }
     shader.setUniform1f(uniformLabel("shininess"), shininess());
   }
 
-  void Emitter::set(const std::string& key, std::any value) {
+  void Emitter::assign(const std::string& key, std::any value) {
     if (key == "color") {
       m_color = std::any_cast<color_t>(value);
     } else {
@@ -99,8 +107,7 @@ namespace api::material {
     }
   }
 
-  void Emitter::shade(const ShaderProgram& shader) const {
-    Material::shade(shader);
+  void Emitter::upload(const ShaderProgram& shader) const {
     shader.setUniform3fv(uniformLabel("color"), color());
   }
 
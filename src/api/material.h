@@ -23,6 +23,8 @@ namespace api::material {
   auto to_inShaderId(MaterialType) -> unsigned int;
 
   auto from_inShaderId(unsigned int) -> std::string;
+  // selects the shading code of a material type in a program variant
+  auto shaderDefine(MaterialType) -> std::string;
 
   auto shaderDeclaration(unsigned int, unsigned int) -> std::string;
 
@@ -38,7 +40,23 @@ namespace api::material {
       , m_type { type }
       , m_name { name } {}
 
-    virtual void shade(const ShaderProgram&) const;
+    // per-draw state : texture units
+    virtual void bindTextures() const {}
+    // uniform values; only needed when the material changed
+    virtual void upload(const ShaderProgram&) const {}
+
+    // whether meshes using different materials of this type can share a
+    // draw call (i.e. all material state lives in indexed uniforms)
+    [[nodiscard]]
+    virtual auto instanceable() const -> bool {
+      return false;
+    }
+
+    // identifies the textures bound by bindTextures; 0 : none
+    [[nodiscard]]
+    virtual auto textureSet() const -> unsigned int {
+      return 0;
+    }
     void         print() const;
 
     // accessors
@@ -92,8 +110,16 @@ namespace api::material {
       }
     }
 
-    virtual void shade(const ShaderProgram&) const override;
-    virtual void set(const std::string& key, std::any value) override;
+    virtual void bindTextures() const override;
+    virtual void upload(const ShaderProgram&) const override;
+    virtual void assign(const std::string& key, std::any value) override;
+
+    [[nodiscard]]
+    auto textureSet() const -> unsigned int override {
+      return (diffuseTexture() != nullptr || specularTexture() != nullptr)
+               ? id() + 1
+               : 0;
+    }
 
     // accessors
     [[nodiscard]]
@@ -112,8 +138,9 @@ namespace api::material {
     }
   };
 
-  static unsigned int DefaultMaterialId { 0 };
-  static unsigned int EmitterMaterialId { 0 };
+  // one counter across translation units : ids pick the uniform slot
+  inline unsigned int DefaultMaterialId { 0 };
+  inline unsigned int EmitterMaterialId { 0 };
 
   class Default : public Normal {
   public:
@@ -132,8 +159,13 @@ namespace api::material {
       configure(params);
     }
 
-    void shade(const ShaderProgram&) const override;
-    void set(const std::string&, std::any) override;
+    void upload(const ShaderProgram&) const override;
+    void assign(const std::string&, std::any) override;
+
+    [[nodiscard]]
+    auto instanceable() const -> bool override {
+      return true;
+    }
 
     // accessors
     [[nodiscard]]
@@ -3,49 +3,45 @@
 
 #include "global.h"
 
+#include "api/geometry.h"
 #include "api/material.h"
 #include "api/object.h"
 #include "api/prefabs.h"
 #include "api/shader.h"
+#include "api/transform.h"
 #include "utils/error.h"
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <any>
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace api::mesh {
   using namespace utils;
+  using namespace api::geometry;
   using namespace api::material;
   using namespace api::shader;
   using namespace api::object;
 
-  static unsigned int MeshId { 0 };
+  inline unsigned int MeshId { 0 };
 
   class Mesh : public Object {
     const unsigned int m_id;
     const std::string  m_name;
 
-    std::vector<float>        m_vertices;
-    std::vector<unsigned int> m_indices;
-    std::vector<float>        m_uvCoords;
-    unsigned int              m_vbo;
+    // meshes created from the same geometry are drawn instanced
+    std::shared_ptr<Geometry> m_geometry;
 
-    vec_t       m_position { 0.0f };
-    vec_t       m_scale { 1.0f };
-    transform_t m_rotation { 1.0f };
-
-    const vec_t*       m_bound_position { nullptr };
-    const vec_t*       m_bound_scale { nullptr };
-    const transform_t* m_bound_rotation { nullptr };
+    // node in the shared transform store
+    transform::handle_t m_node;
 
     Material* m_material { nullptr };
 
-    bool m_buffers_generated { false };
-
-    auto recalculate() const -> std::vector<float>;
+    // never moves once placed : Scene::bakeStatic may merge it
+    bool m_static { false };
 
   public:
     Mesh(const std::string&,
@@ -56,23 +52,23 @@ namespace api::mesh {
     Mesh(const std::string& name, const prefabs::Prefab& obj)
       : Mesh { name, obj.vertices, obj.indices, obj.uvCoords } {}
 
+    Mesh(const std::string&, const std::shared_ptr<Geometry>&);
+
     Mesh(Mesh&& other) noexcept
       : m_id { MeshId++ }
       , m_name { std::move(other.m_name) }
-      , m_vertices { std::move(other.m_vertices) }
-      , m_indices { std::move(other.m_indices) }
-      , m_uvCoords { std::move(other.m_uvCoords) }
-      , m_vbo { other.m_vbo }
-      , m_buffers_generated { other.m_buffers_generated } {}
+      , m_geometry { std::move(other.m_geometry) }
+      , m_node { other.m_node } {
+      other.m_node = transform::npos;
+    }
 
     Mesh(const Mesh&) = delete;
-
     ~Mesh();
 
-    void bindPosition(vec_t* const);
-    void bindScale(vec_t* const);
-    void bindRotation(transform_t* const);
-    void set(const std::string&, std::any) override;
+    // places the mesh relative to another transform node
+    void attachTo(transform::handle_t);
+    void detach();
+    void assign(const std::string&, std::any) override;
 
     void attachMaterial(Material*);
     void identifyMesh(const ShaderProgram&) const;
@@ -83,17 +79,56 @@ namespace api::mesh {
       return m_id;
     }
 
+    [[nodiscard]]
+    auto name() const -> const std::string& {
+      return m_name;
+    }
+
     [[nodiscard]]
     auto label() const -> std::string {
       return m_name + std::to_string(id());
     }
 
     [[nodiscard]]
-    auto transform() const -> transform_t;
+    auto node() const -> transform::handle_t {
+      return m_node;
+    }
+
+    [[nodiscard]]
+    auto isStatic() const -> bool {
+      return m_static;
+    }
+
+    // world matrix as of the last transform store update
+    [[nodiscard]]
+    auto transform() const -> const transform_t& {
+      return transform::store().world(m_node);
+    }
+
+    [[nodiscard]]
+    auto normalMatrix() const -> const glm::mat3& {
+      return transform::store().normal(m_node);
+    }
+
+    [[nodiscard]]
+    auto moved() const -> bool {
+      return transform::store().moved(m_node);
+    }
+
+    // world-space bounds of the geometry under transform()
+    [[nodiscard]]
+    auto aabb() const -> bounds::AABB {
+      return bounds::transformed(m_geometry->aabb(), transform());
+    }
+
+    [[nodiscard]]
+    auto sphere() const -> bounds::Sphere {
+      return bounds::transformed(m_geometry->sphere(), transform());
+    }
 
     [[nodiscard]]
-    auto vbo() const -> unsigned int {
-      return m_vbo;
+    auto geometry() const -> const std::shared_ptr<Geometry>& {
+      return m_geometry;
     }
 
     [[nodiscard]]
@@ -108,7 +143,8 @@ namespace api::mesh {
 
     // methods
     void regenBuffers();
-    void render(const ShaderProgram&) const;
+    // builds the level of detail chain of the shared geometry
+    void generateLods(unsigned int levels, float ratio = 0.5f);
 
     void print() const;
   };
@@ -2,6 +2,11 @@
 
 namespace api::object {
 
+  void Object::set(const std::string& key, std::any value) {
+    assign(key, value);
+    touch();
+  }
+
   void Object::configure(const config_t& config) {
     for (const auto& [key, value] : config) {
       set(key, value);
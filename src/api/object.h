@@ -8,8 +8,26 @@
 namespace api::object {
 
   struct Object {
-    virtual void set(const std::string&, std::any) = 0;
-    void         configure(const config_t&);
+    void set(const std::string&, std::any);
+    void configure(const config_t&);
+
+    // bumped on every property change; consumers compare it against the
+    // version they last uploaded to skip unchanged objects
+    [[nodiscard]]
+    auto version() const -> unsigned long {
+      return m_version;
+    }
+
+  protected:
+    virtual void assign(const std::string&, std::any) = 0;
+
+    // for changes that bypass `set`
+    void touch() {
+      ++m_version;
+    }
+
+  private:
+    unsigned long m_version { 1 };
   };
 
 } // namespace api::object
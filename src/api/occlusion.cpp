@@ -0,0 +1,258 @@
+#include "occlusion.h"
+
+#include "utils/jobs.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if defined(__SSE__) || defined(_M_X64)
+  #include <xmmintrin.h>
+  #define OCCLUSION_SSE
+#endif
+
+namespace api::occlusion {
+
+  namespace {
+    // clip-space w below which a point counts as crossing the near plane
+    constexpr float MinW { 1e-5f };
+
+    auto roundUp(int n) -> int {
+      const auto tile = OcclusionBuffer::Tile;
+      return std::max(tile, (n + tile - 1) / tile * tile);
+    }
+  } // namespace
+
+  OcclusionBuffer::OcclusionBuffer(int width, int height)
+    : m_width { roundUp(width) }
+    , m_height { roundUp(height) }
+    , m_tiles_x { m_width / Tile }
+    , m_tiles_y { m_height / Tile }
+    , m_depth(static_cast<std::size_t>(m_width * m_height), 1.0f)
+    , m_tile_far(static_cast<std::size_t>(m_tiles_x * m_tiles_y), 1.0f) {}
+
+  void OcclusionBuffer::clear() {
+    std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+    std::fill(m_tile_far.begin(), m_tile_far.end(), 1.0f);
+    m_triangles.clear();
+  }
+
+  void OcclusionBuffer::addOccluder(const float*        vertices,
+                                    std::size_t         stride,
+                                    const unsigned int* indices,
+                                    std::size_t         count,
+                                    const transform_t& model_view_projection) {
+    const auto clip = [&](unsigned int v) {
+      const auto* p = &vertices[v * stride];
+      return model_view_projection * glm::vec4(p[0], p[1], p[2], 1.0f);
+    };
+    for (auto i = std::size_t { 0 }; i + 2 < count; i += 3) {
+      setup(clip(indices[i]), clip(indices[i + 1]), clip(indices[i + 2]));
+    }
+  }
+
+  void OcclusionBuffer::setup(const glm::vec4& a,
+                              const glm::vec4& b,
+                              const glm::vec4& c) {
+    // clipping would only add occluder area : drop any triangle that
+    // crosses the near plane instead, as its window depths would go
+    // negative and occlude everything behind them
+    const auto behind = [](const glm::vec4& v) {
+      return v.w <= MinW || v.z < -v.w;
+    };
+    if (behind(a) || behind(b) || behind(c)) {
+      return;
+    }
+    float x[3], y[3], z[3];
+    const glm::vec4* corners[3] = { &a, &b, &c };
+    for (auto k = 0; k < 3; ++k) {
+      const auto& v = *corners[k];
+      x[k]          = (v.x / v.w * 0.5f + 0.5f) * m_width;
+      y[k]          = (v.y / v.w * 0.5f + 0.5f) * m_height;
+      z[k]          = v.z / v.w * 0.5f + 0.5f;
+    }
+    auto area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (area == 0.0f) {
+      return;
+    }
+    // both facings occlude; make the winding counter-clockwise
+    if (area < 0.0f) {
+      std::swap(x[1], x[2]);
+      std::swap(y[1], y[2]);
+      std::swap(z[1], z[2]);
+      area = -area;
+    }
+
+    Triangle t;
+    t.xmin = std::max(0, static_cast<int>(std::floor(
+                           std::min({ x[0], x[1], x[2] }))));
+    t.xmax = std::min(m_width, static_cast<int>(std::ceil(
+                                 std::max({ x[0], x[1], x[2] }))));
+    t.ymin = std::max(0, static_cast<int>(std::floor(
+                           std::min({ y[0], y[1], y[2] }))));
+    t.ymax = std::min(m_height, static_cast<int>(std::ceil(
+                                  std::max({ y[0], y[1], y[2] }))));
+    if (t.xmin >= t.xmax || t.ymin >= t.ymax) {
+      return;
+    }
+    // edge k runs from corner k to corner k + 1, positive inside
+    for (auto k = 0; k < 3; ++k) {
+      const auto n = (k + 1) % 3;
+      t.edge[k][0] = y[k] - y[n];
+      t.edge[k][1] = x[n] - x[k];
+      t.edge[k][2] = x[k] * y[n] - x[n] * y[k];
+    }
+    // window depth is affine in screen space
+    t.depth[0] =
+      ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    t.depth[1] =
+      ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+    t.depth[2] = z[0] - t.depth[0] * x[0] - t.depth[1] * y[0];
+    m_triangles.push_back(t);
+  }
+
+  void OcclusionBuffer::rasterize(const Triangle& t, int y0, int y1) {
+    const auto ya = std::max(t.ymin, y0);
+    const auto yb = std::min(t.ymax, y1);
+    // rows are padded to whole tiles : 4-aligned spans never overrun
+    const auto xa = t.xmin & ~3;
+    for (auto y = ya; y < yb; ++y) {
+      const auto py  = static_cast<float>(y) + 0.5f;
+      auto*      row = &m_depth[static_cast<std::size_t>(y * m_width)];
+#ifdef OCCLUSION_SSE
+      const auto zero    = _mm_setzero_ps();
+      const auto offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+      __m128     a[3], c[3];
+      for (auto k = 0; k < 3; ++k) {
+        a[k] = _mm_set1_ps(t.edge[k][0]);
+        c[k] = _mm_set1_ps(t.edge[k][1] * py + t.edge[k][2]);
+      }
+      const auto za = _mm_set1_ps(t.depth[0]);
+      const auto zc = _mm_set1_ps(t.depth[1] * py + t.depth[2]);
+      for (auto x = xa; x < t.xmax; x += 4) {
+        const auto px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)),
+                                   offsets);
+        auto inside   = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[0], px), c[0]),
+                                     zero);
+        inside        = _mm_and_ps(
+          inside,
+          _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[1], px), c[1]), zero));
+        inside        = _mm_and_ps(
+          inside,
+          _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a[2], px), c[2]), zero));
+        const auto z  = _mm_add_ps(_mm_mul_ps(za, px), zc);
+        const auto d  = _mm_loadu_ps(row + x);
+        const auto closer = _mm_and_ps(inside, _mm_cmplt_ps(z, d));
+        if (_mm_movemask_ps(closer) == 0) {
+          continue;
+        }
+        _mm_storeu_ps(row + x,
+                      _mm_or_ps(_mm_and_ps(closer, z),
+                                _mm_andnot_ps(closer, d)));
+      }
+#else
+      for (auto x = xa; x < t.xmax; ++x) {
+        const auto px     = static_cast<float>(x) + 0.5f;
+        auto       inside = true;
+        for (auto k = 0; k < 3; ++k) {
+          inside = inside &&
+                   t.edge[k][0] * px + t.edge[k][1] * py + t.edge[k][2] >= 0;
+        }
+        const auto z = t.depth[0] * px + t.depth[1] * py + t.depth[2];
+        if (inside && z < row[x]) {
+          row[x] = z;
+        }
+      }
+#endif
+    }
+  }
+
+  void OcclusionBuffer::rasterize() {
+    // bands of tile rows never share pixels : no synchronisation needed
+    const auto band = [&](std::size_t first, std::size_t last) {
+      const auto y0 = static_cast<int>(first) * Tile;
+      const auto y1 = static_cast<int>(last) * Tile;
+      for (const auto& t : m_triangles) {
+        if (t.ymax > y0 && t.ymin < y1) {
+          rasterize(t, y0, y1);
+        }
+      }
+      for (auto ty = static_cast<int>(first); ty < static_cast<int>(last);
+           ++ty) {
+        for (auto tx = 0; tx < m_tiles_x; ++tx) {
+          auto farthest = 0.0f;
+          for (auto y = ty * Tile; y < (ty + 1) * Tile; ++y) {
+            const auto* row = &m_depth[static_cast<std::size_t>(y * m_width)];
+            for (auto x = tx * Tile; x < (tx + 1) * Tile; ++x) {
+              farthest = std::max(farthest, row[x]);
+            }
+          }
+          m_tile_far[static_cast<std::size_t>(ty * m_tiles_x + tx)] = farthest;
+        }
+      }
+    };
+    utils::jobs::pool().parallelFor(0, m_tiles_y, 1, band);
+  }
+
+  auto OcclusionBuffer::occluded(const bounds::AABB& box,
+                                 const transform_t&  view_projection) const
+    -> bool {
+    auto xmin = std::numeric_limits<float>::max();
+    auto ymin = std::numeric_limits<float>::max();
+    auto zmin = std::numeric_limits<float>::max();
+    auto xmax = std::numeric_limits<float>::lowest();
+    auto ymax = std::numeric_limits<float>::lowest();
+    for (auto k = 0; k < 8; ++k) {
+      const auto corner = glm::vec4((k & 1) ? box.max.x : box.min.x,
+                                    (k & 2) ? box.max.y : box.min.y,
+                                    (k & 4) ? box.max.z : box.min.z,
+                                    1.0f);
+      const auto clip   = view_projection * corner;
+      if (clip.w <= MinW) {
+        return false;
+      }
+      const auto x = (clip.x / clip.w * 0.5f + 0.5f) * m_width;
+      const auto y = (clip.y / clip.w * 0.5f + 0.5f) * m_height;
+      xmin         = std::min(xmin, x);
+      xmax         = std::max(xmax, x);
+      ymin         = std::min(ymin, y);
+      ymax         = std::max(ymax, y);
+      zmin         = std::min(zmin, clip.z / clip.w * 0.5f + 0.5f);
+    }
+    if (zmin <= 0.0f) {
+      return false;
+    }
+    const auto xa = std::max(0, static_cast<int>(std::floor(xmin)));
+    const auto xb = std::min(m_width, static_cast<int>(std::ceil(xmax)));
+    const auto ya = std::max(0, static_cast<int>(std::floor(ymin)));
+    const auto yb = std::min(m_height, static_cast<int>(std::ceil(ymax)));
+    if (xa >= xb || ya >= yb) {
+      // off screen : left to frustum culling
+      return false;
+    }
+    for (auto ty = ya / Tile; ty <= (yb - 1) / Tile; ++ty) {
+      for (auto tx = xa / Tile; tx <= (xb - 1) / Tile; ++tx) {
+        const auto t = static_cast<std::size_t>(ty * m_tiles_x + tx);
+        if (m_tile_far[t] < zmin) {
+          // every pixel of the tile is in front of the box
+          continue;
+        }
+        for (auto y = std::max(ya, ty * Tile);
+             y < std::min(yb, (ty + 1) * Tile);
+             ++y) {
+          const auto* row = &m_depth[static_cast<std::size_t>(y * m_width)];
+          for (auto x = std::max(xa, tx * Tile);
+               x < std::min(xb, (tx + 1) * Tile);
+               ++x) {
+            if (row[x] >= zmin) {
+              return false;
+            }
+          }
+        }
+      }
+    }
+    return true;
+  }
+
+} // namespace api::occlusion
@@ -0,0 +1,88 @@
+#ifndef API_OCCLUSION_H
+#define API_OCCLUSION_H
+
+#include "global.h"
+
+#include "api/bounds.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace api::occlusion {
+
+  /*
+   * low resolution software depth buffer for occlusion culling on the cpu;
+   * occluder triangles are rasterized 4 pixels at a time under a coverage
+   * mask, one horizontal band of tiles per job, then every tile keeps its
+   * farthest depth; boxes are tested against those tile depths first and
+   * against single pixels only where a tile cannot decide
+   *
+   * depths are window space, 0 at the near plane and 1 at the far plane;
+   * everything that cannot be resolved exactly (triangles or boxes crossing
+   * the near plane) is treated conservatively : never occluding, never
+   * occluded
+   */
+  class OcclusionBuffer {
+  public:
+    // tile edge in pixels
+    static constexpr int Tile { 8 };
+
+  private:
+    // screen-space triangle, counter-clockwise, with edge and depth planes
+    struct Triangle {
+      float edge[3][3];
+      float depth[3];
+      int   xmin, xmax, ymin, ymax;
+    };
+
+    int m_width;
+    int m_height;
+    int m_tiles_x;
+    int m_tiles_y;
+
+    std::vector<float>    m_depth;
+    // farthest depth of each tile
+    std::vector<float>    m_tile_far;
+    std::vector<Triangle> m_triangles;
+
+    void setup(const glm::vec4&, const glm::vec4&, const glm::vec4&);
+    void rasterize(const Triangle&, int, int);
+
+  public:
+    // width is rounded up to a whole number of tiles
+    OcclusionBuffer(int width = 256, int height = 128);
+
+    void clear();
+    // projects and queues the triangles of one occluder
+    void addOccluder(const float*        vertices,
+                     std::size_t         stride,
+                     const unsigned int* indices,
+                     std::size_t         count,
+                     const transform_t&  model_view_projection);
+    // rasterizes every queued triangle, then reduces the tile depths
+    void rasterize();
+
+    // box entirely behind rasterized occluders
+    [[nodiscard]]
+    auto occluded(const bounds::AABB&, const transform_t&) const -> bool;
+
+    // accessors
+    [[nodiscard]]
+    auto width() const -> int {
+      return m_width;
+    }
+
+    [[nodiscard]]
+    auto height() const -> int {
+      return m_height;
+    }
+
+    [[nodiscard]]
+    auto triangles() const -> std::size_t {
+      return m_triangles.size();
+    }
+  };
+
+} // namespace api::occlusion
+
+#endif // API_OCCLUSION_H
@@ -0,0 +1,143 @@
+#include "permutation.h"
+
+#include "utils/error.h"
+#include "utils/log.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+namespace api::permutation {
+  using namespace utils;
+
+  namespace {
+    // MATERIAL_DEFAULT + FOO -> material_default.foo
+    auto suffix(const defines_t& defines) -> std::string {
+      std::string out;
+      for (const auto& define : defines) {
+        if (!out.empty()) {
+          out += '.';
+        }
+        for (const auto c : define) {
+          out += static_cast<char>(
+            std::tolower(static_cast<unsigned char>(c)));
+        }
+      }
+      return out;
+    }
+
+    void normalize(defines_t& defines) {
+      std::sort(defines.begin(), defines.end());
+      defines.erase(std::unique(defines.begin(), defines.end()),
+                    defines.end());
+    }
+  } // namespace
+
+  Permutations::Permutations(const ShaderProgram&       base,
+                             preprocess::Preprocessor& preprocessor)
+    : m_base { &base }
+    , m_preprocessor { &preprocessor } {}
+
+  auto Permutations::find(defines_t defines) const -> ShaderProgram* {
+    normalize(defines);
+    const auto it = m_lookup.find(defines);
+    return it == m_lookup.end() ? nullptr : m_variants[it->second].get();
+  }
+
+  auto Permutations::build(defines_t                  defines,
+                           const cache::ProgramCache* cache)
+    -> ShaderProgram& {
+    return add(std::move(defines), cache, true);
+  }
+
+  auto Permutations::submit(defines_t                  defines,
+                            const cache::ProgramCache* cache)
+    -> ShaderProgram& {
+    return add(std::move(defines), cache, false);
+  }
+
+  auto Permutations::add(defines_t                  defines,
+                         const cache::ProgramCache* cache,
+                         bool                       wait) -> ShaderProgram& {
+    normalize(defines);
+    const auto name = suffix(defines);
+    if (m_lookup.find(defines) != m_lookup.end()) {
+      raise::error(m_base->label() + " variant already built : " + name);
+    }
+    const auto& vertex   = m_base->vertexShader();
+    const auto& fragment = m_base->fragmentShader();
+    const auto  hashes   = std::make_pair(
+      m_preprocessor->run(vertex.source_in(), vertex.path(), defines, m_vertex),
+      m_preprocessor->run(
+        fragment.source_in(), fragment.path(), defines, m_fragment));
+    const auto same = m_by_hash.find(hashes);
+    if (same != m_by_hash.end()) {
+      log::log(log::DEBUG,
+               m_base->label() + " [" + name + "] shares " +
+                 m_variants[same->second]->label());
+      m_lookup.emplace(std::move(defines), same->second);
+      return *m_variants[same->second];
+    }
+
+    auto variant =
+      create(defines, m_vertex, hashes.first, m_fragment, hashes.second);
+    if (wait) {
+      variant->build(cache);
+      log::log(log::DEBUG, variant->label() + " variant built");
+    } else {
+      variant->submit(cache);
+      log::log(log::DEBUG, variant->label() + " variant submitted");
+    }
+    m_lookup.emplace(std::move(defines), m_variants.size());
+    m_by_hash.emplace(hashes, m_variants.size());
+    m_variants.push_back(std::move(variant));
+    return *m_variants.back();
+  }
+
+  auto Permutations::create(const defines_t& defines,
+                            std::string      vertex,
+                            std::uint64_t    vertex_hash,
+                            std::string      fragment,
+                            std::uint64_t    fragment_hash) const
+    -> std::unique_ptr<ShaderProgram> {
+    const auto name = suffix(defines);
+    auto       variant =
+      std::make_unique<ShaderProgram>(m_base->label() + " [" + name + "]");
+    variant->vertexShader().derive(
+      m_base->vertexShader(), std::move(vertex), vertex_hash, name);
+    variant->fragmentShader().derive(
+      m_base->fragmentShader(), std::move(fragment), fragment_hash, name);
+    return variant;
+  }
+
+  auto Permutations::replace(defines_t                      defines,
+                             std::unique_ptr<ShaderProgram> program)
+    -> std::unique_ptr<ShaderProgram> {
+    normalize(defines);
+    const auto it = m_lookup.find(defines);
+    if (it == m_lookup.end()) {
+      raise::error(m_base->label() + " has no variant " + suffix(defines));
+    }
+    const auto old    = it->second;
+    const auto shared = std::count_if(m_lookup.begin(),
+                                      m_lookup.end(),
+                                      [&](const auto& entry) {
+                                        return entry.second == old;
+                                      }) > 1;
+    const auto hashes = std::make_pair(program->vertexShader().hash(),
+                                       program->fragmentShader().hash());
+    std::unique_ptr<ShaderProgram> previous;
+    if (shared) {
+      it->second = m_variants.size();
+      m_variants.push_back(std::move(program));
+    } else {
+      for (auto h = m_by_hash.begin(); h != m_by_hash.end();) {
+        h = h->second == old ? m_by_hash.erase(h) : std::next(h);
+      }
+      previous = std::exchange(m_variants[old], std::move(program));
+    }
+    m_by_hash[hashes] = it->second;
+    return previous;
+  }
+
+} // namespace api::permutation
@@ -0,0 +1,88 @@
+#ifndef API_PERMUTATION_H
+#define API_PERMUTATION_H
+
+#include "api/cache.h"
+#include "api/preprocess.h"
+#include "api/shader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace api::permutation {
+  using namespace api::shader;
+
+  // preprocessor symbols selecting one variant, e.g. { "MATERIAL_DEFAULT" }
+  using defines_t = std::vector<std::string>;
+
+  /*
+   * specialized programs generated from the files of one template program,
+   * preprocessed with a set of #defines each; a variant is compiled and
+   * linked the first time it is built, through the program cache when one
+   * is given, and kept for the life of the set. define sets that expand to
+   * the same sources share one program. the template itself is never
+   * linked; it and the preprocessor must outlive the set
+   */
+  class Permutations {
+    const ShaderProgram*                        m_base;
+    preprocess::Preprocessor*                   m_preprocessor;
+    std::vector<std::unique_ptr<ShaderProgram>> m_variants;
+    // sorted defines -> index into m_variants
+    std::map<defines_t, std::size_t>            m_lookup;
+    // (vertex, fragment) content hashes -> index into m_variants
+    std::map<std::pair<std::uint64_t, std::uint64_t>, std::size_t> m_by_hash;
+
+    // expansion buffers, reused across builds
+    std::string m_vertex;
+    std::string m_fragment;
+
+    auto add(defines_t, const cache::ProgramCache*, bool wait)
+      -> ShaderProgram&;
+
+  public:
+    Permutations(const ShaderProgram&, preprocess::Preprocessor&);
+
+    // nullptr until built
+    [[nodiscard]]
+    auto find(defines_t) const -> ShaderProgram*;
+    // compiles and links; the order of defines never makes a new variant
+    auto build(defines_t, const cache::ProgramCache* = nullptr)
+      -> ShaderProgram&;
+    // same, but only submits the compile and link unless the cache holds
+    // the program; the caller polls ready() and calls finish() with the
+    // same cache before using it
+    auto submit(defines_t, const cache::ProgramCache* = nullptr)
+      -> ShaderProgram&;
+    // unlinked variant over sources expanded elsewhere, e.g. off the gl
+    // thread for a rebuild
+    [[nodiscard]]
+    auto create(const defines_t&,
+                std::string   vertex,
+                std::uint64_t vertex_hash,
+                std::string   fragment,
+                std::uint64_t fragment_hash) const
+      -> std::unique_ptr<ShaderProgram>;
+    // swaps a linked rebuild in for a built variant; returns the previous
+    // program unless another define set still shares it
+    auto replace(defines_t, std::unique_ptr<ShaderProgram>)
+      -> std::unique_ptr<ShaderProgram>;
+
+    // accessors
+    [[nodiscard]]
+    auto base() const -> const ShaderProgram& {
+      return *m_base;
+    }
+
+    [[nodiscard]]
+    auto size() const -> std::size_t {
+      return m_variants.size();
+    }
+  };
+
+} // namespace api::permutation
+
+#endif // API_PERMUTATION_H
@@ -0,0 +1,152 @@
+#include "preprocess.h"
+
+#include "utils/error.h"
+#include "utils/hash.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+namespace api::preprocess {
+  using namespace utils;
+
+  namespace {
+    auto skipBlanks(std::string_view s, std::size_t i) -> std::size_t {
+      while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) {
+        ++i;
+      }
+      return i;
+    }
+
+    // name of the directive on this line and the text after it, if any
+    auto directive(std::string_view line)
+      -> std::pair<std::string_view, std::string_view> {
+      auto i = skipBlanks(line, 0);
+      if (i == line.size() || line[i] != '#') {
+        return {};
+      }
+      i               = skipBlanks(line, i + 1);
+      const auto name = i;
+      while (i < line.size() &&
+             (std::isalnum(static_cast<unsigned char>(line[i])) ||
+              line[i] == '_')) {
+        ++i;
+      }
+      const auto rest = skipBlanks(line, i);
+      auto       end  = line.size();
+      while (end > rest && (line[end - 1] == ' ' || line[end - 1] == '\t' ||
+                            line[end - 1] == '\r')) {
+        --end;
+      }
+      return { line.substr(name, i - name), line.substr(rest, end - rest) };
+    }
+
+    void define(const std::vector<std::string>& defines, std::string& out) {
+      for (const auto& d : defines) {
+        out.append("#define ").append(d).push_back('\n');
+      }
+    }
+  } // namespace
+
+  void Preprocessor::setBlock(const std::string& name, std::string text) {
+    if (!text.empty() && text.back() != '\n') {
+      text.push_back('\n');
+    }
+    m_blocks[name] = std::move(text);
+  }
+
+  void Preprocessor::forget() {
+    m_files.clear();
+  }
+
+  auto Preprocessor::file(const std::filesystem::path& path)
+    -> const std::string& {
+    const auto key = path.generic_string();
+    const auto it  = m_files.find(key);
+    if (it != m_files.end()) {
+      return it->second;
+    }
+    std::ifstream stream(path);
+    if (!stream) {
+      raise::error("failed to read shader include : " + key);
+    }
+    std::stringstream contents;
+    contents << stream.rdbuf();
+    return m_files.emplace(key, contents.str()).first->second;
+  }
+
+  auto Preprocessor::run(std::string_view                source,
+                         const std::filesystem::path&    origin,
+                         const std::vector<std::string>& defines,
+                         std::string&                    out) -> std::uint64_t {
+    out.clear();
+    out.reserve(source.size() + source.size() / 2);
+    m_once.clear();
+    m_stack.assign(1, origin.lexically_normal().generic_string());
+    // without #version the defines simply go first
+    if (source.find("#version") == std::string_view::npos) {
+      define(defines, out);
+      expand(source, origin, nullptr, out);
+    } else {
+      expand(source, origin, &defines, out);
+    }
+    return hash::fnv1a(out);
+  }
+
+  void Preprocessor::expand(std::string_view                source,
+                            const std::filesystem::path&    path,
+                            const std::vector<std::string>* defines,
+                            std::string&                    out) {
+    auto pos = std::size_t { 0 };
+    while (pos < source.size()) {
+      auto end = source.find('\n', pos);
+      if (end == std::string_view::npos) {
+        end = source.size();
+      }
+      const auto line = source.substr(pos, end - pos);
+      const auto [name, rest] = directive(line);
+      pos                     = end + 1;
+
+      if (name == "include") {
+        const auto open  = rest.find('"');
+        const auto close = rest.find('"', open + 1);
+        if (open != 0 || close == std::string_view::npos) {
+          raise::error(path.generic_string() + " : malformed include " +
+                       std::string(line));
+        }
+        const auto included =
+          (path.parent_path() / std::string(rest.substr(1, close - 1)))
+            .lexically_normal();
+        const auto key = included.generic_string();
+        if (m_once.count(key) != 0) {
+          continue;
+        }
+        if (std::find(m_stack.begin(), m_stack.end(), key) != m_stack.end()) {
+          raise::error(path.generic_string() + " : include cycle through " +
+                       key);
+        }
+        m_stack.push_back(key);
+        expand(file(included), included, nullptr, out);
+        m_stack.pop_back();
+      } else if (name == "pragma" && rest == "once") {
+        m_once.insert(m_stack.back());
+      } else if (name == "block") {
+        const auto block = m_blocks.find(std::string(rest));
+        if (block == m_blocks.end()) {
+          raise::error(path.generic_string() + " : block " +
+                       std::string(rest) + " was never set");
+        }
+        out.append(block->second);
+      } else {
+        out.append(line).push_back('\n');
+        if (name == "version" && defines != nullptr) {
+          define(*defines, out);
+          defines = nullptr;
+        }
+      }
+    }
+  }
+
+} // namespace api::preprocess
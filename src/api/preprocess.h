@@ -0,0 +1,57 @@
+#ifndef API_PREPROCESS_H
+#define API_PREPROCESS_H
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace api::preprocess {
+
+  /*
+   * expands the directives glsl itself lacks, line by line :
+   *
+   *   #include "file"  relative to the including file; a file starting
+   *                    with #pragma once is expanded at most once
+   *   #block name      replaced by the text set for `name`; a block that
+   *                    was never set is an error
+   *
+   * defines are injected right after #version. everything else, including
+   * #ifndef guards, is left to the glsl compiler. included files are read
+   * once and kept, the output buffer is reused by the caller, so running
+   * hundreds of permutations costs little more than the copies
+   */
+  class Preprocessor {
+    // path -> contents
+    std::unordered_map<std::string, std::string> m_files;
+    std::unordered_map<std::string, std::string> m_blocks;
+
+    // per run
+    std::unordered_set<std::string> m_once;
+    std::vector<std::string>        m_stack;
+
+    auto file(const std::filesystem::path&) -> const std::string&;
+    void expand(std::string_view,
+                const std::filesystem::path&,
+                const std::vector<std::string>*,
+                std::string&);
+
+  public:
+    void setBlock(const std::string& name, std::string text);
+    // drops cached files, e.g. after they changed on disk
+    void forget();
+
+    // expands `source`, read from `origin`, into `out`; returns the hash of
+    // the result
+    auto run(std::string_view                source,
+             const std::filesystem::path&    origin,
+             const std::vector<std::string>& defines,
+             std::string&                    out) -> std::uint64_t;
+  };
+
+} // namespace api::preprocess
+
+#endif // API_PREPROCESS_H
@@ -0,0 +1,145 @@
+#include "query.h"
+
+#include <glad/gl.h>
+
+#include <cstddef>
+#include <vector>
+
+namespace api::query {
+
+  namespace {
+    // corners of the unit cube, bit k of the index selects max on axis k
+    constexpr float CubeVertices[] = {
+      0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 0.0f,
+      0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f,
+    };
+
+    constexpr unsigned int CubeIndices[] = {
+      0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+      2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5,
+    };
+  } // namespace
+
+  OcclusionQueries::OcclusionQueries() {
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_vbo);
+    glGenBuffers(1, &m_ebo);
+    glBindVertexArray(m_vao);
+    {
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+      glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                   sizeof(CubeIndices),
+                   CubeIndices,
+                   GL_STATIC_DRAW);
+      glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+      glBufferData(GL_ARRAY_BUFFER,
+                   sizeof(CubeVertices),
+                   CubeVertices,
+                   GL_STATIC_DRAW);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
+      glEnableVertexAttribArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+    glBindVertexArray(0);
+  }
+
+  OcclusionQueries::~OcclusionQueries() {
+    resize(0);
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteVertexArrays(1, &m_vao);
+  }
+
+  void OcclusionQueries::resize(std::size_t n) {
+    for (auto s = n; s < m_slots.size(); ++s) {
+      glDeleteQueries(Ring, m_slots[s].ids);
+    }
+    const auto old = m_slots.size();
+    m_slots.resize(n);
+    for (auto s = old; s < n; ++s) {
+      auto& slot = m_slots[s];
+      glGenQueries(Ring, slot.ids);
+      for (auto k = 0u; k < Ring; ++k) {
+        slot.issued[k] = 0;
+      }
+      slot.last    = 0;
+      slot.visible = true;
+    }
+  }
+
+  void OcclusionQueries::poll() {
+    ++m_frame;
+    for (auto& slot : m_slots) {
+      // newest available result wins, anything older is dropped
+      for (auto age = 1u; age <= Latency && age < m_frame; ++age) {
+        const auto k = (m_frame - age) % Ring;
+        if (slot.issued[k] != m_frame - age) {
+          continue;
+        }
+        unsigned int available = 0;
+        glGetQueryObjectuiv(slot.ids[k], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+          continue;
+        }
+        unsigned int samples = 0;
+        glGetQueryObjectuiv(slot.ids[k], GL_QUERY_RESULT, &samples);
+        slot.visible = samples != 0;
+        for (auto& issued : slot.issued) {
+          if (issued <= m_frame - age) {
+            issued = 0;
+          }
+        }
+        break;
+      }
+    }
+  }
+
+  void OcclusionQueries::reset(std::size_t s) {
+    // results still in flight describe a view that no longer applies
+    auto& slot = m_slots[s];
+    for (auto& issued : slot.issued) {
+      issued = 0;
+    }
+    slot.last    = 0;
+    slot.visible = true;
+  }
+
+  void OcclusionQueries::begin(const ShaderProgram& shader) const {
+    shader.use();
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+    glBindVertexArray(m_vao);
+  }
+
+  void OcclusionQueries::issue(std::size_t          s,
+                               const bounds::AABB&  box,
+                               const ShaderProgram& shader) {
+    auto&      slot = m_slots[s];
+    // a query still pending after Latency frames is abandoned here
+    const auto k    = m_frame % Ring;
+    shader.setUniform3fv(shader.uniformLocation("boxMin"), box.min);
+    shader.setUniform3fv(shader.uniformLocation("boxMax"), box.max);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED, slot.ids[k]);
+    glDrawElements(GL_TRIANGLES,
+                   sizeof(CubeIndices) / sizeof(CubeIndices[0]),
+                   GL_UNSIGNED_INT,
+                   0);
+    glEndQuery(GL_ANY_SAMPLES_PASSED);
+    slot.issued[k] = m_frame;
+    slot.last      = slot.ids[k];
+  }
+
+  void OcclusionQueries::end() const {
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  }
+
+  auto inflated(const bounds::AABB& box) -> bounds::AABB {
+    const auto pad = box.extent() * 0.01f + vec_t(1e-3f);
+    return { box.min - pad, box.max + pad };
+  }
+
+} // namespace api::query
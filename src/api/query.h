@@ -0,0 +1,89 @@
+#ifndef API_QUERY_H
+#define API_QUERY_H
+
+#include "global.h"
+
+#include "api/bounds.h"
+#include "api/shader.h"
+
+#include <cstddef>
+#include <vector>
+
+namespace api::query {
+  using namespace api::shader;
+
+  /*
+   * hardware occlusion queries on bounding boxes : every slot owns a ring
+   * of GL_ANY_SAMPLES_PASSED queries, one issued per frame; results are
+   * only collected once the gpu reports them available, one or two frames
+   * later, so reading them back never stalls the pipeline
+   */
+  class OcclusionQueries {
+  public:
+    // frames a query may stay in flight before its object is reused
+    static constexpr unsigned int Latency { 2 };
+
+  private:
+    static constexpr unsigned int Ring { Latency + 1 };
+
+    struct Slot {
+      unsigned int  ids[Ring];
+      // frame each query was issued in, 0 : no result pending
+      unsigned long issued[Ring];
+      // newest query issued, 0 : none yet
+      unsigned int  last;
+      bool          visible;
+    };
+
+    std::vector<Slot> m_slots;
+    unsigned long     m_frame { 0 };
+
+    // unit cube drawn for every box
+    unsigned int m_vao;
+    unsigned int m_vbo;
+    unsigned int m_ebo;
+
+  public:
+    OcclusionQueries();
+    ~OcclusionQueries();
+
+    OcclusionQueries(const OcclusionQueries&) = delete;
+
+    void resize(std::size_t);
+    // starts a frame and picks up every result that became available
+    void poll();
+    // no box was drawn for the slot this frame : treat it as visible
+    void reset(std::size_t);
+
+    // draws the boxes of several slots with color and depth writes off
+    // and a depth test that passes on equal depths; the program must take
+    // the box corners as boxMin and boxMax
+    void begin(const ShaderProgram&) const;
+    void issue(std::size_t, const bounds::AABB&, const ShaderProgram&);
+    void end() const;
+
+    // accessors
+    // result of the newest collected query, true until one arrives
+    [[nodiscard]]
+    auto visible(std::size_t s) const -> bool {
+      return m_slots[s].visible;
+    }
+
+    // newest query object, for conditional rendering
+    [[nodiscard]]
+    auto last(std::size_t s) const -> unsigned int {
+      return m_slots[s].last;
+    }
+
+    [[nodiscard]]
+    auto size() const -> std::size_t {
+      return m_slots.size();
+    }
+  };
+
+  // box grown a little, so its faces never sit on the surfaces it bounds
+  auto inflated(const bounds::AABB&) -> bounds::AABB;
+
+} // namespace api::query
+
+#endif // API_QUERY_H
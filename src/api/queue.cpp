@@ -0,0 +1,69 @@
+#include "queue.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+
+namespace api::queue {
+
+  auto makeKey(Pass         pass,
+               unsigned int program,
+               unsigned int material,
+               unsigned int textures,
+               float        depth) -> std::uint64_t {
+    // depth is expected in [0, 1]; quantized to 16 bits
+    const auto d = static_cast<std::uint64_t>(
+      std::clamp(depth, 0.0f, 1.0f) * 65535.0f);
+    return (static_cast<std::uint64_t>(pass) & 0xF) << 60 |
+           (static_cast<std::uint64_t>(program) & 0xFFF) << 48 |
+           (static_cast<std::uint64_t>(material) & 0xFF) << 40 |
+           (static_cast<std::uint64_t>(textures) & 0xFFFFFF) << 16 | d;
+  }
+
+  void RenderQueue::sort() {
+    const auto n = m_packets.size();
+    if (n < 2) {
+      return;
+    }
+    m_scratch.resize(n);
+    for (auto shift = 0u; shift < 64; shift += 8) {
+      std::size_t count[256] = { 0 };
+      for (const auto& p : m_packets) {
+        ++count[(p.key >> shift) & 0xFF];
+      }
+      // every key has the same digit : nothing to reorder
+      if (count[(m_packets[0].key >> shift) & 0xFF] == n) {
+        continue;
+      }
+      std::size_t offset = 0;
+      for (auto& c : count) {
+        const auto tmp = c;
+        c              = offset;
+        offset        += tmp;
+      }
+      for (const auto& p : m_packets) {
+        m_scratch[count[(p.key >> shift) & 0xFF]++] = p;
+      }
+      m_packets.swap(m_scratch);
+    }
+  }
+
+  void Stats::print() const {
+    printf("draws %u : culled %u (occluded %u) : queries %u (skipped %u) : "
+           "program %u (-%u) : textures %u (-%u) : "
+           "uniforms %u (-%u) : tile lights %u",
+           draws,
+           culled,
+           occluded,
+           queries,
+           query_skipped,
+           program_binds,
+           program_binds_skipped,
+           texture_binds,
+           texture_binds_skipped,
+           uniform_uploads,
+           uniform_uploads_skipped,
+           tile_lights);
+  }
+
+} // namespace api::queue
@@ -0,0 +1,92 @@
+#ifndef API_QUEUE_H
+#define API_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace api::queue {
+
+  enum class Pass : std::uint8_t {
+    Opaque = 0,
+  };
+
+  /*
+   * 64-bit draw sort key, most significant field first:
+   *   pass [4] | program [12] | material [8] | texture set [24] | depth [16]
+   * sorting by key groups draws by the most expensive state first and
+   * orders draws front-to-back within identical state
+   */
+  auto makeKey(Pass,
+               unsigned int program,
+               unsigned int material,
+               unsigned int textures,
+               float        depth) -> std::uint64_t;
+
+  struct Packet {
+    std::uint64_t key;
+    unsigned int  payload;
+  };
+
+  // per-frame state change counters
+  struct Stats {
+    unsigned int draws { 0 };
+    unsigned int culled { 0 };
+    // part of culled : inside the frustum but hidden behind occluders
+    unsigned int occluded { 0 };
+    // hardware occlusion queries issued, and draws skipped on their
+    // delayed results
+    unsigned int queries { 0 };
+    unsigned int query_skipped { 0 };
+    unsigned int program_binds { 0 };
+    unsigned int program_binds_skipped { 0 };
+    unsigned int texture_binds { 0 };
+    unsigned int texture_binds_skipped { 0 };
+    unsigned int uniform_uploads { 0 };
+    unsigned int uniform_uploads_skipped { 0 };
+    // (tile, light) pairs binned by the tiled path
+    unsigned int tile_lights { 0 };
+
+    void print() const;
+  };
+
+  class RenderQueue {
+    std::vector<Packet> m_packets;
+    std::vector<Packet> m_scratch;
+
+  public:
+    void clear() {
+      m_packets.clear();
+    }
+
+    void push(std::uint64_t key, unsigned int payload) {
+      m_packets.push_back({ key, payload });
+    }
+
+    // sized up front so packets can be written from several threads
+    void resize(std::size_t n) {
+      m_packets.resize(n);
+    }
+
+    void set(std::size_t i, std::uint64_t key, unsigned int payload) {
+      m_packets[i] = { key, payload };
+    }
+
+    // stable lsd radix sort on the key, skipping uniform digits
+    void sort();
+
+    // accessors
+    [[nodiscard]]
+    auto packets() const -> const std::vector<Packet>& {
+      return m_packets;
+    }
+
+    [[nodiscard]]
+    auto size() const -> std::size_t {
+      return m_packets.size();
+    }
+  };
+
+} // namespace api::queue
+
+#endif // API_QUEUE_H
@@ -3,30 +3,43 @@
 #include "api/light.h"
 #include "api/material.h"
 #include "api/mesh.h"
+#include "utils/error.h"
+#include "utils/jobs.h"
 #include "utils/log.h"
 
 #include <glad/gl.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
 #include <cstdio>
 #include <filesystem>
+#include <fstream>
+#include <limits>
 #include <map>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <tuple>
 
 namespace api::scene {
   using namespace api::shader;
   using namespace api::light;
   using namespace utils;
 
-  Scene::Scene() : m_light_shader { "lightsource" } {
-    glGenVertexArrays(1, &m_vao);
-    glGenVertexArrays(1, &m_light_vao);
+  Scene::Scene()
+    : m_camera_ubo { "camera block", CameraBinding }
+    , m_lights_ubo { "lights block", LightsBinding }
+    , m_query_shader { "boundingbox" }
+    , m_light_shader { "lightsource" } {
+    glGenBuffers(1, &m_instance_vbo);
   }
 
   Scene::~Scene() {
-    glDeleteVertexArrays(1, &m_light_vao);
-    glDeleteVertexArrays(1, &m_vao);
+    glDeleteBuffers(1, &m_instance_vbo);
   }
 
   void Scene::addMaterial(Material* p_material) {
@@ -37,6 +50,19 @@ namespace api::scene {
     }
   }
 
+  void Scene::addOccluder(Mesh* p_mesh) {
+    if (p_mesh == nullptr) {
+      raise::error("occluder mesh is null");
+    } else if (std::find(m_meshes.begin(), m_meshes.end(), p_mesh) ==
+               m_meshes.end()) {
+      raise::error("occluder mesh was not added to the scene: " +
+                   p_mesh->label());
+    } else {
+      m_occluders.push_back(p_mesh);
+      m_batches_dirty = true;
+    }
+  }
+
   auto Scene::material(unsigned int m) -> Material* {
     if (m >= m_materials.size()) {
       raise::error("material index out of bounds");
@@ -46,76 +72,153 @@ namespace api::scene {
     }
   }
 
+  auto Scene::pick(const vec_t& origin,
+                   const vec_t& direction,
+                   float        distance) const -> const Mesh* {
+    // merged static meshes are resolved to the meshes baked into them
+    const auto hit    = m_bvh.raycast(origin, direction, distance, m_is_baked);
+    const auto source = m_static_bvh.raycast(origin, direction, hit.t);
+    if (source.primitive != bvh::npos) {
+      return m_static_sources[source.primitive];
+    }
+    return hit.primitive == bvh::npos ? nullptr : m_bvh_meshes[hit.primitive];
+  }
+
+  auto Scene::nearest(const vec_t& point) const -> Hit {
+    const auto hit    = m_bvh.nearest(point, m_is_baked);
+    const auto source = m_static_bvh.nearest(point);
+    if (source.primitive != bvh::npos && source.t < hit.t) {
+      return { m_static_sources[source.primitive], source.t };
+    }
+    if (hit.primitive == bvh::npos) {
+      return {};
+    }
+    return { m_bvh_meshes[hit.primitive], hit.t };
+  }
+
+  void Scene::bakeStatic(float chunk) {
+    if (chunk <= 0.0f) {
+      raise::error("static chunk size must be positive");
+    }
+    transform::store().update();
+
+    using cell_t = std::tuple<Material*, int, int, int>;
+    std::map<cell_t, std::vector<const Mesh*>> cells;
+    std::vector<Mesh*>                         kept;
+    for (const auto& mesh : m_meshes) {
+      if (!mesh->isStatic()) {
+        kept.push_back(mesh);
+        continue;
+      }
+      mesh->regenBuffers();
+      const auto c = mesh->aabb().center() / chunk;
+      cells[cell_t { mesh->material(),
+                     static_cast<int>(std::floor(c.x)),
+                     static_cast<int>(std::floor(c.y)),
+                     static_cast<int>(std::floor(c.z)) }]
+        .push_back(mesh);
+    }
+    if (cells.empty()) {
+      log::log(log::WARNING, "no static meshes to bake");
+      return;
+    }
+
+    std::vector<bounds::AABB> boxes;
+    for (const auto& [cell, meshes] : cells) {
+      std::vector<float>        vertices;
+      std::vector<unsigned int> indices;
+      std::vector<float>        uv_coords;
+      auto                      levels   = std::size_t { 1 };
+      auto                      occluder = false;
+      for (const auto& mesh : meshes) {
+        // from the gpu streams, which snapshot geometry has as well :
+        // positions of every vertex, uvs per corner of the full level
+        const auto& geometry = *mesh->geometry();
+        const auto& world    = mesh->transform();
+        const auto  source   = geometry.gpuVertices();
+        const auto  corners  = geometry.gpuIndices();
+        const auto  base     = static_cast<unsigned int>(vertices.size() / 3);
+        for (auto v = std::size_t { 0 }; v < source.size(); v += VertexStride) {
+          const auto p =
+            world * glm::vec4(source[v], source[v + 1], source[v + 2], 1.0f);
+          vertices.insert(vertices.end(), { p.x, p.y, p.z });
+        }
+        for (auto i = 0u; i < geometry.lods().front().count; ++i) {
+          const auto v = corners[i];
+          indices.push_back(base + v);
+          uv_coords.insert(uv_coords.end(),
+                           { source[v * VertexStride + 6],
+                             source[v * VertexStride + 7] });
+        }
+        levels = std::max(levels, geometry.lods().size());
+        const auto it = std::find(m_occluders.begin(), m_occluders.end(), mesh);
+        if (it != m_occluders.end()) {
+          m_occluders.erase(it);
+          occluder = true;
+        }
+        m_static_sources.push_back(mesh);
+        boxes.push_back(mesh->aabb());
+      }
+      auto baked =
+        std::make_unique<Mesh>("static", vertices, indices, uv_coords);
+      baked->attachMaterial(std::get<0>(cell));
+      baked->regenBuffers();
+      if (levels > 1) {
+        baked->generateLods(static_cast<unsigned int>(levels));
+      }
+      if (occluder) {
+        m_occluders.push_back(baked.get());
+      }
+      kept.push_back(baked.get());
+      m_baked.push_back(std::move(baked));
+    }
+    const auto count = boxes.size();
+    // keep any earlier bake pickable
+    for (auto p = 0u; p < m_static_bvh.size(); ++p) {
+      boxes.insert(boxes.begin() + p, m_static_bvh.box(p));
+    }
+    m_static_bvh.build(boxes);
+    log::log(log::INFO,
+             std::to_string(count) + " static meshes baked into " +
+               std::to_string(cells.size()) + " chunks");
+    m_meshes        = std::move(kept);
+    m_batches_dirty = true;
+  }
+
   void Scene::addMesh(Mesh* p_mesh) {
-    m_meshes.push_back(p_mesh);
-    glBindVertexArray(m_vao);
-    {
-      glBindBuffer(GL_ARRAY_BUFFER, p_mesh->vbo());
-      {
-        // position attribute
-        glVertexAttribPointer(0,
-                              3,
-                              GL_FLOAT,
-                              GL_FALSE,
-                              8 * sizeof(float),
-                              (void*)0);
-        glEnableVertexAttribArray(0);
-        // normal attribute
-        glVertexAttribPointer(1,
-                              3,
-                              GL_FLOAT,
-                              GL_FALSE,
-                              8 * sizeof(float),
-                              (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
-        // uv attribute
-        glVertexAttribPointer(2,
-                              2,
-                              GL_FLOAT,
-                              GL_FALSE,
-                              8 * sizeof(float),
-                              (void*)(6 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-      }
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    if (p_mesh == nullptr) {
+      raise::error("mesh is null");
+    } else {
+      m_meshes.push_back(p_mesh);
+      m_batches_dirty = true;
     }
-    glBindVertexArray(0);
   }
 
   void Scene::addLightMesh(Mesh* p_mesh) {
     m_light_mesh = p_mesh;
-    glBindVertexArray(m_light_vao);
-    {
-      glBindBuffer(GL_ARRAY_BUFFER, m_light_mesh->vbo());
-      {
-        // position attribute
-        glVertexAttribPointer(0,
-                              3,
-                              GL_FLOAT,
-                              GL_FALSE,
-                              8 * sizeof(float),
-                              (void*)0);
-        glEnableVertexAttribArray(0);
-      }
-      glBindBuffer(GL_ARRAY_BUFFER, 0);
-    }
-    glBindVertexArray(0);
   }
 
   void Scene::addLight(LightSource* p_light) {
+    if (p_light == nullptr) {
+      raise::error("light source is null");
+    }
     m_lights.push_back(p_light);
     if (p_light->type() != LightType::Distant) {
       m_positional_lights.push_back(dynamic_cast<Positional*>(p_light));
-      m_meshes.push_back(new mesh::Mesh("lightsource", prefabs::Cube()));
-      m_meshes.back()->regenBuffers();
+      if (m_light_geometry == nullptr) {
+        m_light_geometry = std::make_shared<Geometry>("lightsource",
+                                                      prefabs::Cube());
+        m_light_geometry->regenBuffers();
+      }
+      m_meshes.push_back(new mesh::Mesh("lightsource", m_light_geometry));
+      m_batches_dirty = true;
       auto emitter = new material::Emitter("lightsource material");
       emitter->set("color",
                    p_light->diffuseStrength() > p_light->specularStrength()
                      ? p_light->diffuseColor()
                      : p_light->specularColor());
       m_meshes.back()->attachMaterial(emitter);
-      m_meshes.back()->bindPosition(
-        dynamic_cast<Positional*>(p_light)->position_ptr);
+      m_meshes.back()->attachTo(dynamic_cast<Positional*>(p_light)->node());
       m_meshes.back()->configure({
         {"scale", vec_t { 0.1f }}
       });
@@ -123,76 +226,872 @@ namespace api::scene {
   }
 
   void Scene::configureShaders() {
-    for (auto& shader : m_shaders) {
-      std::string light_declarations    = "";
-      std::string light_calls           = "";
-      std::string material_declarations = "";
+    std::string light_declarations    = "";
+    std::string light_calls           = "";
+    std::string material_declarations = "";
+    if (m_deferred != nullptr) {
+      // lights are applied by deferred::Renderer
+    } else if (m_light_grid != nullptr) {
+      // the same for any set of lights
+      light_calls = "    " + tiles::shaderCall() + "\n";
+    } else {
       for (const auto& light : m_lights) {
-        light_declarations += light->shaderDeclaration() + "\n";
-        light_calls        += "\n    " + light->shaderCall();
-      }
-      shader.fragmentShader().replaceString("/* subst: light sources */",
-                                            light_declarations);
-      shader.fragmentShader().replaceString("/* subst: light calculations */",
-                                            light_calls);
-      std::map<unsigned int, unsigned int> number_of_materials;
-      for (const auto& mesh : m_meshes) {
-        const auto inShaderId = mesh->material()->inShaderId();
-        if (number_of_materials.find(inShaderId) == number_of_materials.end()) {
-          number_of_materials[inShaderId] = 1;
-        } else {
-          number_of_materials[inShaderId]++;
+        light_declarations += "  " + light->shaderDeclaration() + "\n";
+        light_calls        += "    " + light->shaderCall() + "\n";
+      }
+    }
+    if (!light_declarations.empty()) {
+      light_declarations = "layout(std140) uniform Lights {\n" +
+                           light_declarations + "};\n";
+    }
+    std::map<unsigned int, unsigned int> number_of_materials;
+    for (const auto& mesh : m_meshes) {
+      const auto inShaderId = mesh->material()->inShaderId();
+      if (number_of_materials.find(inShaderId) == number_of_materials.end()) {
+        number_of_materials[inShaderId] = 1;
+      } else {
+        number_of_materials[inShaderId]++;
+      }
+    }
+    for (const auto& [id, count] : number_of_materials) {
+      material_declarations += api::material::shaderDeclaration(id, count) +
+                               "\n";
+    }
+    m_preprocessor.setBlock("light_sources", light_declarations);
+    m_preprocessor.setBlock("light_calculations", light_calls);
+    m_preprocessor.setBlock("materials", material_declarations);
+    // variants expand the shader files against these blocks
+    m_permutations.clear();
+    m_programs.clear();
+    m_program_slots.clear();
+    m_fallbacks.assign(m_shaders.size(), nullptr);
+    m_compiling.clear();
+    for (const auto& shader : m_shaders) {
+      m_permutations.emplace_back(*shader, m_preprocessor);
+    }
+  }
+
+  auto Scene::program(unsigned int shader, MaterialType type)
+    -> unsigned int {
+    const auto key = std::make_pair(shader, type);
+    const auto it  = m_program_slots.find(key);
+    if (it != m_program_slots.end()) {
+      return it->second;
+    }
+    if (shader >= m_permutations.size()) {
+      raise::error("no shader " + std::to_string(shader) +
+                   ", configure shaders first");
+    }
+    auto& substitute = fallback(shader);
+    auto& variant    = m_permutations[shader].submit(
+      this->variant(material::shaderDefine(type)), m_program_cache.get());
+    const auto slot = static_cast<unsigned int>(m_programs.size());
+    if (variant.is_linked()) {
+      variant.bindUniformBlock("Camera", CameraBinding);
+      variant.bindUniformBlock("Lights", LightsBinding);
+      m_programs.push_back(&variant);
+    } else {
+      if (m_compiling.empty()) {
+        m_compile_start = std::chrono::steady_clock::now();
+      }
+      m_programs.push_back(&substitute);
+      m_compiling.emplace_back(slot, &variant);
+    }
+    m_program_slots.emplace(key, slot);
+    return slot;
+  }
+
+  auto Scene::fallback(unsigned int shader) -> ShaderProgram& {
+    if (m_fallbacks[shader] == nullptr) {
+      auto& unlit = m_permutations[shader].build(variant("MATERIAL_FALLBACK"),
+                                                 m_program_cache.get());
+      unlit.bindUniformBlock("Camera", CameraBinding);
+      m_fallbacks[shader] = &unlit;
+    }
+    return *m_fallbacks[shader];
+  }
+
+  auto Scene::variant(const std::string& material) const
+    -> permutation::defines_t {
+    if (m_deferred != nullptr) {
+      return { material, deferred::Renderer::Define };
+    }
+    return { material };
+  }
+
+  void Scene::pollCompiles() {
+    if (m_compiling.empty()) {
+      return;
+    }
+    const auto* program_cache = m_program_cache.get();
+    const auto  done          = [&](const auto& compiling) {
+      auto& [slot, variant] = compiling;
+      if (!variant->ready()) {
+        return false;
+      }
+      if (variant->finish(program_cache)) {
+        variant->bindUniformBlock("Camera", CameraBinding);
+        variant->bindUniformBlock("Lights", LightsBinding);
+        m_programs[slot] = variant;
+      } else {
+        log::log(log::WARNING,
+                 variant->label() + " keeps drawing with its fallback");
+      }
+      return true;
+    };
+    m_compiling.erase(
+      std::remove_if(m_compiling.begin(), m_compiling.end(), done),
+      m_compiling.end());
+    if (m_compiling.empty()) {
+      const auto elapsed = std::chrono::duration_cast<
+        std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                   m_compile_start);
+      log::log(log::INFO,
+               "shader variants ready after " +
+                 std::to_string(elapsed.count()) + " ms");
+    }
+  }
+
+  void Scene::useTiledLighting() {
+    m_deferred.reset();
+    m_light_grid = std::make_unique<tiles::LightGrid>();
+  }
+
+  void Scene::useDeferredShading(const std::filesystem::path& shader_path) {
+    m_light_grid.reset();
+    m_deferred = std::make_unique<deferred::Renderer>(shader_path);
+  }
+
+  void Scene::useProgramCache(const std::filesystem::path& dir) {
+    m_program_cache = std::make_unique<cache::ProgramCache>(dir);
+  }
+
+  void Scene::watchShaders(const std::filesystem::path& dir) {
+    m_shader_watcher = std::make_unique<watch::FileWatcher>(dir);
+  }
+
+  namespace {
+    auto readFile(const std::string& path) -> std::string {
+      std::ifstream file(path);
+      if (!file) {
+        raise::error("failed to read shader file : " + path);
+      }
+      std::stringstream contents;
+      contents << file.rdbuf();
+      return contents.str();
+    }
+  } // namespace
+
+  void Scene::startReload() {
+    m_reload      = std::make_unique<Reload>();
+    auto& reload  = *m_reload;
+    // same blocks, includes read afresh
+    reload.preprocessor = m_preprocessor;
+    reload.preprocessor.forget();
+    std::vector<std::pair<std::string, std::string>> paths;
+    for (const auto& shader : m_shaders) {
+      paths.emplace_back(shader->vertexShader().path(),
+                         shader->fragmentShader().path());
+    }
+    for (const auto& [key, slot] : m_program_slots) {
+      reload.rebuilds.push_back({ key.first,
+                                  slot,
+                                  variant(material::shaderDefine(key.second)),
+                                  {},
+                                  {},
+                                  0,
+                                  0,
+                                  nullptr });
+    }
+    reload.worker = std::thread(
+      [&reload, paths = std::move(paths)] {
+        try {
+          for (const auto& [vertex, fragment] : paths) {
+            reload.sources.emplace_back(readFile(vertex), readFile(fragment));
+          }
+          for (auto& r : reload.rebuilds) {
+            const auto& [vertex, fragment] = reload.sources[r.shader];
+            r.vertex_hash   = reload.preprocessor.run(vertex,
+                                                    paths[r.shader].first,
+                                                    r.defines,
+                                                    r.vertex);
+            r.fragment_hash = reload.preprocessor.run(fragment,
+                                                      paths[r.shader].second,
+                                                      r.defines,
+                                                      r.fragment);
+          }
+        } catch (const std::exception& e) {
+          reload.error = e.what();
         }
+        reload.done.store(true, std::memory_order_release);
+      });
+  }
+
+  void Scene::reloadShaders() {
+    if (m_shader_watcher == nullptr) {
+      return;
+    }
+    if (m_reload == nullptr) {
+      if (!m_compiling.empty()) {
+        // changes stay queued until the variants in flight have linked
+        return;
+      }
+      // compiled sources are dumped next to the files : only inputs count
+      const auto changed = m_shader_watcher->changes();
+      const auto inputs  = std::any_of(
+        changed.begin(), changed.end(), [](const std::filesystem::path& p) {
+          return p.extension() == ".in" || p.extension() == ".glsl";
+        });
+      if (inputs && !m_program_slots.empty()) {
+        log::log(log::INFO, "shader sources changed, rebuilding");
+        startReload();
+      }
+      return;
+    }
+    auto& reload = *m_reload;
+    if (!reload.done.load(std::memory_order_acquire)) {
+      return;
+    }
+    if (!reload.error.empty()) {
+      log::log(log::WARNING,
+               "shader reload failed, keeping current programs : " +
+                 reload.error);
+      m_reload.reset();
+      return;
+    }
+    if (!reload.submitted) {
+      for (auto& r : reload.rebuilds) {
+        r.program = m_permutations[r.shader].create(r.defines,
+                                                    std::move(r.vertex),
+                                                    r.vertex_hash,
+                                                    std::move(r.fragment),
+                                                    r.fragment_hash);
+        r.program->submit();
       }
-      for (const auto& [id, count] : number_of_materials) {
-        material_declarations += api::material::shaderDeclaration(id, count) +
-                                 "\n";
+      reload.submitted = true;
+      return;
+    }
+    for (const auto& r : reload.rebuilds) {
+      if (!r.program->ready()) {
+        return;
       }
-      shader.fragmentShader().replaceString("/* subst: materials */",
-                                            material_declarations);
     }
+    auto linked = true;
+    for (auto& r : reload.rebuilds) {
+      linked = r.program->finish() && linked;
+    }
+    if (!linked) {
+      log::log(log::WARNING, "shader reload failed, keeping current programs");
+      m_reload.reset();
+      return;
+    }
+    // all programs change between the same two frames
+    for (auto& r : reload.rebuilds) {
+      r.program->bindUniformBlock("Camera", CameraBinding);
+      r.program->bindUniformBlock("Lights", LightsBinding);
+      m_programs[r.slot] = r.program.get();
+      m_permutations[r.shader].replace(r.defines, std::move(r.program));
+    }
+    for (auto s = std::size_t { 0 }; s < m_shaders.size(); ++s) {
+      m_shaders[s]->vertexShader().reset(std::move(reload.sources[s].first));
+      m_shaders[s]->fragmentShader().reset(
+        std::move(reload.sources[s].second));
+    }
+    m_preprocessor.forget();
+    log::log(log::SUCCESS,
+             "reloaded " + std::to_string(reload.rebuilds.size()) +
+               " shader programs");
+    m_reload.reset();
   }
 
   void Scene::compileShaders() {
-    for (auto& shader : m_shaders) {
-      shader.compile();
-      shader.link();
+    const auto* program_cache = m_program_cache.get();
+    // variants for the materials already present, all submitted before any
+    // is waited on so the driver can compile them in parallel; any other
+    // one is submitted when first drawn
+    for (auto s = 0u; s < m_permutations.size(); ++s) {
+      for (const auto& mesh : m_meshes) {
+        program(s, mesh->material()->type());
+      }
+    }
+    if (m_deferred != nullptr) {
+      m_deferred->build(m_preprocessor, program_cache);
+    }
+    if (m_queries_enabled) {
+      m_query_shader.build(program_cache);
+      m_query_shader.bindUniformBlock("Camera", CameraBinding);
+    }
+    if (program_cache != nullptr && program_cache->supported()) {
+      log::log(log::INFO,
+               "program cache : " + std::to_string(program_cache->hits()) +
+                 " hits, " + std::to_string(program_cache->misses()) +
+                 " misses");
     }
   }
 
   void Scene::addShader(const std::string&           shader_name,
                         const std::filesystem::path& shader_path) {
-    m_shaders.emplace_back(shader_name);
-    m_shaders.back().readShadersFromPaths(
+    m_shaders.push_back(std::make_unique<ShaderProgram>(shader_name));
+    m_shaders.back()->readShadersFromPaths(
       (shader_path / shader_name).generic_string() + ".vert.in",
       (shader_path / shader_name).generic_string() + ".frag.in");
   }
 
-  void Scene::render(unsigned int shader, float time) const {
-    const auto activeShader = m_shaders[shader];
-    activeShader.use();
-    activeShader.setUniform1f("time", time);
-    for (const auto& light : m_lights) {
-      if (light == nullptr) {
-        log::log(log::WARNING, "light source is null");
+  void Scene::addQueryShader(const std::filesystem::path& shader_path) {
+    m_query_shader.readShadersFromPaths(
+      (shader_path / m_query_shader.label()).generic_string() + ".vert.in",
+      (shader_path / m_query_shader.label()).generic_string() + ".frag.in");
+    m_query_shader.preprocess(m_preprocessor);
+    m_queries_enabled = true;
+    m_batches_dirty   = true;
+  }
+
+  void Scene::snapshot(frame::FramePacket& packet, float time) const {
+    transform::store().update();
+    packet.time = time;
+
+    packet.camera_version = camera.version();
+    packet.camera.clear();
+    camera.pack(packet.camera);
+    packet.view_projection = camera.project() * camera.view();
+    packet.eye             = camera.position();
+    packet.znear           = camera.zNear();
+    packet.zfar            = camera.zFar();
+    // an orthographic view keeps full detail at any distance
+    packet.lod_scale =
+      camera.type() == CameraType::Perspective
+        ? packet.height / (2.0f * std::tan(glm::radians(camera.fov()) * 0.5f))
+        : 0.0f;
+
+    packet.light_versions.clear();
+    packet.light_offsets.clear();
+    packet.lights.clear();
+    packet.packed_lights.clear();
+    packet.distant_lights = 0;
+    if (m_light_grid != nullptr || m_deferred != nullptr) {
+      // distant lights first, they cover the whole screen
+      for (const auto distant : { true, false }) {
+        for (const auto& light : m_lights) {
+          if ((light->type() == LightType::Distant) != distant) {
+            continue;
+          }
+          packet.light_versions.push_back(light->version());
+          light->pack(packet.packed_lights.emplace_back());
+          packet.distant_lights += distant ? 1 : 0;
+        }
+      }
+    } else {
+      for (const auto& light : m_lights) {
+        packet.lights.beginStruct();
+        packet.light_offsets.push_back(packet.lights.size());
+        packet.light_versions.push_back(light->version());
+        light->pack(packet.lights);
+        packet.lights.endStruct();
+      }
+      packet.light_offsets.push_back(packet.lights.size());
+    }
+
+    const auto& transforms = transform::store();
+    packet.world           = transforms.worlds();
+    packet.normal          = transforms.normals();
+    packet.revision        = transforms.revisions();
+  }
+
+  void Scene::uploadCamera(const frame::FramePacket& packet) {
+    if (packet.camera_version == m_camera_version) {
+      return;
+    }
+    m_camera_ubo.upload(packet.camera);
+    m_camera_version = packet.camera_version;
+  }
+
+  void Scene::uploadLights(const frame::FramePacket& packet) {
+    const auto& versions = packet.light_versions;
+    if (m_deferred != nullptr) {
+      if (versions != m_light_versions) {
+        m_deferred->upload(packet.packed_lights, packet.distant_lights);
+        m_light_versions = versions;
+      }
+      return;
+    }
+    if (m_light_grid != nullptr) {
+      // small next to the tile lists rebuilt every frame : sent whole
+      if (versions != m_light_versions) {
+        m_light_grid->upload(packet.packed_lights);
+        m_light_versions = versions;
+      }
+      m_light_grid->build(packet);
+      m_stats.tile_lights = static_cast<unsigned int>(m_light_grid->binned());
+      return;
+    }
+    // packing happened in snapshot; only the changed byte range is sent
+    m_light_versions.resize(versions.size(), 0);
+    auto dirty_begin = std::numeric_limits<std::size_t>::max();
+    auto dirty_end   = std::size_t { 0 };
+    for (auto l = 0u; l < versions.size(); ++l) {
+      if (versions[l] != m_light_versions[l]) {
+        dirty_begin         = std::min(dirty_begin, packet.light_offsets[l]);
+        dirty_end           = packet.light_offsets[l + 1];
+        m_light_versions[l] = versions[l];
+      }
+    }
+    if (dirty_end > 0) {
+      m_lights_ubo.upload(packet.lights, dirty_begin, dirty_end - dirty_begin);
+    }
+  }
+
+  void Scene::render(const frame::FramePacket& packet, unsigned int shader) {
+    reloadShaders();
+    pollCompiles();
+    m_stats = {};
+    uploadCamera(packet);
+    uploadLights(packet);
+    m_queries.poll();
+
+    if (m_batches_dirty || !collectInstances(packet)) {
+      rebuildBatches(packet);
+      m_stats.culled   = 0;
+      m_stats.occluded = 0;
+      collectInstances(packet);
+    }
+    uploadInstances();
+
+    m_drawn.clear();
+    for (auto b = 0u; b < m_batches.size(); ++b) {
+      const auto& batch = m_batches[b];
+      if (batch.instance_count == 0) {
+        continue;
+      }
+      if (batch.query != NoQuery && !m_queries.visible(batch.query)) {
+        ++m_stats.query_skipped;
+        continue;
+      }
+      m_drawn.push_back(b);
+    }
+    // variants may have to be built : resolved here, on the gl thread
+    m_drawn_programs.resize(m_drawn.size());
+    for (auto i = std::size_t { 0 }; i < m_drawn.size(); ++i) {
+      m_drawn_programs[i] = program(shader,
+                                    m_batches[m_drawn[i]].material->type());
+    }
+    m_queue.resize(m_drawn.size());
+    const auto keys = [&](std::size_t first, std::size_t last) {
+      for (auto i = first; i < last; ++i) {
+        const auto& batch = m_batches[m_drawn[i]];
+        m_queue.set(i,
+                    queue::makeKey(queue::Pass::Opaque,
+                                   m_drawn_programs[i],
+                                   batch.material->inShaderId(),
+                                   batch.material->textureSet(),
+                                   batch.depth),
+                    m_drawn[i]);
+      }
+    };
+    jobs::pool().parallelFor(0, m_drawn.size(), 256, keys);
+    m_queue.sort();
+
+    m_time = packet.time;
+    if (m_deferred != nullptr &&
+        !m_deferred->begin(packet.width, packet.height)) {
+      return;
+    }
+    // queries test against the depth of every batch without one, before
+    // the batches they guard are drawn under them
+    submit(false);
+    issueQueries(packet);
+    submit(true);
+    if (m_deferred != nullptr) {
+      m_deferred->shade();
+    }
+  }
+
+  void Scene::submit(bool queried) {
+    auto program     = -1;
+    auto texture_set = static_cast<unsigned int>(-1);
+    auto last_synced = static_cast<const Material*>(nullptr);
+    m_arena.bind();
+    if (m_light_grid != nullptr) {
+      m_light_grid->bind();
+    }
+    for (const auto& packet : m_queue.packets()) {
+      const auto& batch = m_batches[packet.payload];
+      if ((batch.query != NoQuery) != queried) {
+        continue;
+      }
+      const auto  p            = static_cast<int>((packet.key >> 48) & 0xFFF);
+      const auto& activeShader = *m_programs[p];
+      if (p != program) {
+        activeShader.use();
+        activeShader.setUniform1f("time", m_time);
+        if (m_light_grid != nullptr) {
+          m_light_grid->setUniforms(activeShader);
+        }
+        program     = p;
+        last_synced = nullptr;
+        ++m_stats.program_binds;
+      } else {
+        ++m_stats.program_binds_skipped;
+      }
+      for (const auto& mesh : batch.meshes) {
+        const auto material = mesh->material();
+        if (material == last_synced) {
+          continue;
+        }
+        if (!activeShader.isSynced(*material)) {
+          material->upload(activeShader);
+          activeShader.markSynced(*material);
+          ++m_stats.uniform_uploads;
+        } else {
+          ++m_stats.uniform_uploads_skipped;
+        }
+        last_synced = material;
+      }
+      if (batch.material->textureSet() != texture_set) {
+        batch.material->bindTextures();
+        texture_set = batch.material->textureSet();
+        ++m_stats.texture_binds;
       } else {
-        light->illuminate(activeShader);
+        ++m_stats.texture_binds_skipped;
+      }
+      // this frame's query drops the draw on the gpu side once it is in
+      const auto condition =
+        batch.query != NoQuery ? m_queries.last(batch.query) : 0u;
+      if (condition != 0) {
+        glBeginConditionalRender(condition, GL_QUERY_NO_WAIT);
+      }
+      auto first = batch.first_instance;
+      for (auto l = 0u; l < batch.lod_counts.size(); ++l) {
+        const auto count = batch.lod_counts[l];
+        if (count == 0) {
+          continue;
+        }
+        m_arena.bindInstances(m_instance_vbo, first * sizeof(Instance));
+        m_arena.draw(batch.handle, static_cast<unsigned int>(count), l);
+        first += count;
+        ++m_stats.draws;
       }
+      if (condition != 0) {
+        glEndConditionalRender();
+      }
+    }
+    glBindVertexArray(0);
+  }
+
+  namespace {
+    // coarsest level whose error stays under the tolerance on screen
+    auto selectLod(const std::vector<Lod>& lods,
+                   unsigned int            previous,
+                   float                   pixels_per_unit,
+                   float                   tolerance,
+                   float                   hysteresis) -> unsigned int {
+      for (auto l = static_cast<unsigned int>(lods.size()) - 1; l > 0; --l) {
+        const auto limit = l > previous ? tolerance * hysteresis : tolerance;
+        if (lods[l].error * pixels_per_unit <= limit) {
+          return l;
+        }
+      }
+      return 0;
     }
-    activeShader.setUniform3fv("camera.position", camera.position());
-    activeShader.setUniformMatrix4fv("camera.view", camera.view());
-    activeShader.setUniformMatrix4fv("camera.projection", camera.project());
-    glBindVertexArray(m_vao);
+  } // namespace
+
+  void Scene::rebuildBatches(const frame::FramePacket& packet) {
+    using key_t = std::tuple<const Geometry*,
+                             MaterialType,
+                             const Material*,
+                             const Mesh*>;
+    std::map<key_t, std::size_t> batch_of;
+    m_batches.clear();
+    auto queries = 0u;
     for (const auto& mesh : m_meshes) {
       if (mesh == nullptr) {
         log::log(log::WARNING, "mesh is null");
+        continue;
+      }
+      const auto material  = mesh->material();
+      const auto expensive = m_queries_enabled &&
+                             mesh->geometry()->lods().front().count >=
+                               QueryMinIndices;
+      // instanceable materials are told apart by their per-instance index
+      const auto key = key_t { mesh->geometry().get(),
+                               material->type(),
+                               material->instanceable() ? nullptr : material,
+                               expensive ? mesh : nullptr };
+      const auto it  = batch_of.find(key);
+      if (it == batch_of.end()) {
+        batch_of[key] = m_batches.size();
+        const auto geometry = mesh->geometry().get();
+        m_batches.push_back({ geometry,
+                              resident(geometry),
+                              geometry->revision(),
+                              material,
+                              { mesh },
+                              0,
+                              0,
+                              1.0f,
+                              {},
+                              expensive ? queries++ : NoQuery });
       } else {
-        activeShader.setUniformMatrix4fv("model", mesh->transform());
-        mesh->material()->shade(activeShader);
-        mesh->render(activeShader);
+        m_batches[it->second].meshes.push_back(mesh);
       }
     }
-    glBindVertexArray(0);
+    m_batches_dirty = false;
+
+    std::vector<bounds::AABB> boxes;
+    m_bvh_meshes.clear();
+    m_bvh_revisions.clear();
+    // slot mapping changed : start every query over
+    m_queries.resize(0);
+    m_queries.resize(queries);
+    m_query_primitives.resize(queries);
+    for (const auto& batch : m_batches) {
+      if (batch.query != NoQuery) {
+        m_query_primitives[batch.query] =
+          static_cast<unsigned int>(m_bvh_meshes.size());
+      }
+      for (const auto& mesh : batch.meshes) {
+        boxes.push_back(bounds::transformed(batch.geometry->aabb(),
+                                            packet.world[mesh->node()]));
+        m_bvh_meshes.push_back(mesh);
+        m_bvh_revisions.push_back(packet.revision[mesh->node()]);
+      }
+    }
+    m_bvh.build(boxes);
+    m_lod_levels.assign(m_bvh_meshes.size(), 0);
+    m_occluder_primitives.clear();
+    m_is_occluder.assign(m_bvh_meshes.size(), 0);
+    m_is_baked.assign(m_bvh_meshes.size(), 0);
+    for (auto p = 0u; p < m_bvh_meshes.size(); ++p) {
+      for (const auto& baked : m_baked) {
+        if (baked.get() == m_bvh_meshes[p]) {
+          m_is_baked[p] = 1;
+        }
+      }
+      if (std::find(m_occluders.begin(), m_occluders.end(), m_bvh_meshes[p]) !=
+          m_occluders.end()) {
+        m_occluder_primitives.push_back(p);
+        m_is_occluder[p] = 1;
+      }
+    }
+    log::log(log::DEBUG,
+             std::to_string(m_meshes.size()) + " meshes grouped into " +
+               std::to_string(m_batches.size()) + " instanced batches");
+  }
+
+  auto Scene::resident(const Geometry* geometry) -> unsigned int {
+    if (!geometry->buffersGenerated()) {
+      raise::error("buffers not generated for geometry: " + geometry->name());
+    }
+    const auto it = m_resident.find(geometry);
+    if (it != m_resident.end()) {
+      if (it->second.second == geometry->revision()) {
+        return it->second.first;
+      }
+      // regenerated since the upload : give the old range back
+      m_arena.release(it->second.first);
+    }
+    const auto handle    = m_arena.allocate(*geometry);
+    m_resident[geometry] = { handle, geometry->revision() };
+    return handle;
+  }
+
+  auto Scene::collectInstances(const frame::FramePacket& packet) -> bool {
+    m_instances.clear();
+    for (const auto& batch : m_batches) {
+      if (batch.geometry->revision() != batch.revision) {
+        // geometry was regenerated after batching
+        return false;
+      }
+      for (const auto& mesh : batch.meshes) {
+        const auto material = mesh->material();
+        if (material != batch.material &&
+            (!material->instanceable() ||
+             material->type() != batch.material->type())) {
+          // material was reattached after batching
+          return false;
+        }
+        const auto  node = mesh->node();
+        const auto& n    = packet.normal[node];
+        m_instances.push_back({ packet.world[node],
+                                { glm::vec4(n[0], 0.0f),
+                                  glm::vec4(n[1], 0.0f),
+                                  glm::vec4(n[2], 0.0f) },
+                                material->id(),
+                                {} });
+        // only meshes that moved touch the hierarchy
+        const auto p = static_cast<unsigned int>(m_instances.size() - 1);
+        if (packet.revision[node] != m_bvh_revisions[p]) {
+          m_bvh.update(p,
+                       bounds::transformed(batch.geometry->aabb(),
+                                           m_instances.back().model));
+          m_bvh_revisions[p] = packet.revision[node];
+        }
+      }
+    }
+    if (m_bvh.degraded()) {
+      log::log(log::DEBUG, "rebuilding scene hierarchy");
+      m_bvh.rebuild();
+    }
+
+    // the hierarchy accepts or rejects whole subtrees; meshes it leaves
+    // straddling a plane are retested by sphere 4 at a time, then by box
+    const auto frustum = bounds::Frustum(packet.view_projection);
+    m_bvh.cull(frustum, m_visible);
+    m_spheres.clear();
+    m_candidates.clear();
+    for (auto p = 0u; p < m_visible.size(); ++p) {
+      if (m_visible[p] == bounds::Intersect) {
+        const auto& geometry = m_bvh_meshes[p]->geometry();
+        m_spheres.push(
+          bounds::transformed(geometry->sphere(), m_instances[p].model));
+        m_candidates.push_back(p);
+      }
+    }
+    m_spheres.cull(frustum, m_candidate_visible);
+    for (auto c = 0u; c < m_candidates.size(); ++c) {
+      const auto p = m_candidates[c];
+      if (!m_candidate_visible[c] || !frustum.intersects(m_bvh.box(p))) {
+        m_visible[p] = bounds::Outside;
+      }
+    }
+    if (!m_occluder_primitives.empty()) {
+      cullOccluded(packet);
+    }
+
+    auto in  = std::size_t { 0 };
+    auto out = std::size_t { 0 };
+    m_instance_levels.resize(m_instances.size());
+    for (auto& batch : m_batches) {
+      const auto& lods     = batch.geometry->lods();
+      batch.first_instance = out;
+      batch.depth          = 1.0f;
+      batch.lod_counts.assign(lods.size(), 0);
+      for (auto i = 0u; i < batch.meshes.size(); ++i, ++in) {
+        const auto& model = m_instances[in].model;
+        if (m_visible[in] == bounds::Outside) {
+          ++m_stats.culled;
+          continue;
+        }
+        // nearest instance decides the depth bucket of the batch
+        const auto distance = glm::length(vec_t(model[3]) - packet.eye);
+        batch.depth         = std::min(batch.depth, distance / packet.zfar);
+        if (lods.size() > 1 && packet.lod_scale > 0.0f && distance > 0.0f) {
+          // the largest axis scale bounds how far the error is stretched
+          const auto scale = std::max({ glm::length(vec_t(model[0])),
+                                        glm::length(vec_t(model[1])),
+                                        glm::length(vec_t(model[2])) });
+          m_lod_levels[in] = static_cast<unsigned char>(
+            selectLod(lods,
+                      m_lod_levels[in],
+                      scale * packet.lod_scale / distance,
+                      LodTolerance,
+                      LodHysteresis));
+        } else {
+          m_lod_levels[in] = 0;
+        }
+        ++batch.lod_counts[m_lod_levels[in]];
+        m_instance_levels[out] = m_lod_levels[in];
+        m_instances[out++]     = m_instances[in];
+      }
+      batch.instance_count = out - batch.first_instance;
+
+      // group the visible instances level by level, one draw each
+      if (batch.instance_count > batch.lod_counts[0]) {
+        m_lod_scratch.assign(m_instances.begin() + batch.first_instance,
+                             m_instances.begin() + out);
+        std::vector<std::size_t> next(lods.size(), batch.first_instance);
+        for (auto l = 1u; l < lods.size(); ++l) {
+          next[l] = next[l - 1] + batch.lod_counts[l - 1];
+        }
+        for (auto k = 0u; k < m_lod_scratch.size(); ++k) {
+          const auto level = m_instance_levels[batch.first_instance + k];
+          m_instances[next[level]++] = m_lod_scratch[k];
+        }
+      }
+    }
+    m_instances.resize(out);
+    return true;
+  }
+
+  void Scene::cullOccluded(const frame::FramePacket& packet) {
+    // occluders are drawn at their coarsest level : they only need to
+    // cover, and a hidden occluder cannot hide anything visible either
+    m_occlusion.clear();
+    for (const auto p : m_occluder_primitives) {
+      if (m_visible[p] == bounds::Outside) {
+        continue;
+      }
+      const auto& geometry = m_bvh_meshes[p]->geometry();
+      const auto& lod      = geometry->lods().back();
+      m_occlusion.addOccluder(geometry->gpuVertices().data(),
+                              VertexStride,
+                              geometry->gpuIndices().data() + lod.first,
+                              lod.count,
+                              packet.view_projection * m_instances[p].model);
+    }
+    m_occlusion.rasterize();
+
+    // occluders are never tested : their own surface would hide their box
+    std::atomic<unsigned int> occluded { 0 };
+    const auto                test = [&](std::size_t first, std::size_t last) {
+      auto count = 0u;
+      for (auto p = first; p < last; ++p) {
+        if (m_visible[p] != bounds::Outside && !m_is_occluder[p] &&
+            m_occlusion.occluded(m_bvh.box(static_cast<unsigned int>(p)),
+                                 packet.view_projection)) {
+          m_visible[p] = bounds::Outside;
+          ++count;
+        }
+      }
+      occluded.fetch_add(count, std::memory_order_relaxed);
+    };
+    jobs::pool().parallelFor(0, m_visible.size(), 64, test);
+    m_stats.occluded += occluded.load();
+  }
+
+  void Scene::issueQueries(const frame::FramePacket& packet) {
+    if (m_queries.size() == 0) {
+      return;
+    }
+    m_queries.begin(m_query_shader);
+    for (const auto& batch : m_batches) {
+      if (batch.query == NoQuery) {
+        continue;
+      }
+      const auto  box =
+        query::inflated(m_bvh.box(m_query_primitives[batch.query]));
+      // culled on the cpu, or a box the near plane cuts into : the box
+      // faces say nothing, assume visible until the next query
+      const auto& eye    = packet.eye;
+      const auto  margin = packet.znear;
+      const auto  inside =
+        eye.x >= box.min.x - margin && eye.x <= box.max.x + margin &&
+        eye.y >= box.min.y - margin && eye.y <= box.max.y + margin &&
+        eye.z >= box.min.z - margin && eye.z <= box.max.z + margin;
+      if (batch.instance_count == 0 || inside) {
+        m_queries.reset(batch.query);
+        continue;
+      }
+      m_queries.issue(batch.query, box, m_query_shader);
+      ++m_stats.queries;
+    }
+    m_queries.end();
+  }
+
+  void Scene::uploadInstances() {
+    const auto size = m_instances.size() * sizeof(Instance);
+    glBindBuffer(GL_ARRAY_BUFFER, m_instance_vbo);
+    if (size > m_instance_capacity) {
+      glBufferData(GL_ARRAY_BUFFER, size, m_instances.data(), GL_STREAM_DRAW);
+      m_instance_capacity = size;
+    } else {
+      // orphan the previous storage so the upload does not wait on the gpu
+      glBufferData(GL_ARRAY_BUFFER,
+                   m_instance_capacity,
+                   nullptr,
+                   GL_STREAM_DRAW);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, size, m_instances.data());
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
   }
 
   void Scene::print() const {
@@ -207,6 +1106,19 @@ namespace api::scene {
       mesh->print();
       printf("\n");
     }
+    printf("  Batches: %ld\n", m_batches.size());
+    printf("  Static: %ld meshes baked into %ld chunks\n",
+           m_static_sources.size(),
+           m_baked.size());
+    printf("  Geometry arena:\n    ");
+    m_arena.print();
+    printf("\n");
+    printf("  Hierarchy:\n    ");
+    m_bvh.print();
+    printf("\n");
+    printf("  Last frame:\n    ");
+    m_stats.print();
+    printf("\n");
     printf("  Lights:\n");
     for (const auto& light : m_lights) {
       printf("    ");
@@ -214,9 +1126,9 @@ namespace api::scene {
       printf("\n");
     }
     printf("  Shaders:\n");
-    for (const auto& shader : m_shaders) {
+    for (const auto* shader : m_programs) {
       printf("    ");
-      shader.print();
+      shader->print();
       printf("\n");
     }
     printf("\n..................\n");
@@ -1,31 +1,242 @@
 #ifndef API_SCENE_H
 #define API_SCENE_H
 
+#include "api/arena.h"
+#include "api/bounds.h"
+#include "api/bvh.h"
+#include "api/cache.h"
+#include "api/deferred.h"
 #include "api/camera.h"
+#include "api/frame.h"
+#include "api/geometry.h"
 #include "api/light.h"
 #include "api/material.h"
 #include "api/mesh.h"
+#include "api/occlusion.h"
+#include "api/permutation.h"
+#include "api/preprocess.h"
+#include "api/query.h"
+#include "api/queue.h"
 #include "api/shader.h"
+#include "api/tiles.h"
+#include "api/uniform.h"
+#include "utils/watch.h"
 
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <map>
+#include <memory>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace api::scene {
   using namespace api::shader;
   using namespace api::light;
   using namespace api::mesh;
+  using namespace api::arena;
   using namespace api::camera;
+  using namespace api::geometry;
+  using namespace api::uniform;
+
+  // mesh found by a spatial query, and how far it is
+  struct Hit {
+    const Mesh* mesh { nullptr };
+    float       t { 0.0f };
+  };
 
   class Scene {
-    unsigned int               m_vao;
     std::vector<Mesh*>         m_meshes;
     std::vector<Material*>     m_materials;
     std::vector<LightSource*>  m_lights;
-    std::vector<ShaderProgram> m_shaders;
+    std::vector<std::unique_ptr<ShaderProgram>> m_shaders;
+    // optional, see useProgramCache
+    std::unique_ptr<cache::ProgramCache> m_program_cache;
+    // expands #include and #block in every shader source
+    preprocess::Preprocessor               m_preprocessor;
+    // variants of each m_shaders entry, made by configureShaders
+    std::vector<permutation::Permutations> m_permutations;
+    // program drawn for each variant slot, the fallback of its shader while
+    // the variant compiles; the program field of a sort key indexes this
+    std::vector<ShaderProgram*>            m_programs;
+    std::map<std::pair<unsigned int, MaterialType>, unsigned int>
+      m_program_slots;
+    // unlit variant of each shader, built up front and drawn in place of
+    // variants still compiling
+    std::vector<ShaderProgram*>                          m_fallbacks;
+    // (slot, variant) submitted to the driver and not yet linked
+    std::vector<std::pair<unsigned int, ShaderProgram*>> m_compiling;
+    std::chrono::steady_clock::time_point                m_compile_start;
+
+    // slot of the variant of a shader for a material type, submitted on the
+    // first request; gl thread only
+    auto program(unsigned int shader, MaterialType) -> unsigned int;
+    auto fallback(unsigned int shader) -> ShaderProgram&;
+    // defines of the variant for a material define in the current mode
+    [[nodiscard]]
+    auto variant(const std::string&) const -> permutation::defines_t;
+    // links the variants the driver finished, never waiting
+    void pollCompiles();
+
+    // one built variant being rebuilt after its files changed
+    struct Rebuild {
+      unsigned int                   shader;
+      unsigned int                   slot;
+      permutation::defines_t         defines;
+      // expanded off the gl thread
+      std::string                    vertex;
+      std::string                    fragment;
+      std::uint64_t                  vertex_hash { 0 };
+      std::uint64_t                  fragment_hash { 0 };
+      std::unique_ptr<ShaderProgram> program;
+    };
+
+    // in-flight hot reload : expanded on a thread of its own, so file
+    // reads never hold up a pool worker, compiled asynchronously, swapped
+    // in between two frames once every program linked
+    struct Reload {
+      std::thread              worker;
+      std::atomic<bool>        done { false };
+      preprocess::Preprocessor preprocessor;
+      // file sources (vertex, fragment) of each m_shaders entry
+      std::vector<std::pair<std::string, std::string>> sources;
+      std::vector<Rebuild>     rebuilds;
+      // set by the job when reading or expanding failed
+      std::string              error;
+      bool                     submitted { false };
+
+      ~Reload() {
+        if (worker.joinable()) {
+          worker.join();
+        }
+      }
+    };
+
+    std::unique_ptr<watch::FileWatcher> m_shader_watcher;
+    std::unique_ptr<Reload>             m_reload;
+
+    void startReload();
+    // advances the hot reload by one step, never waiting; gl thread only
+    void reloadShaders();
+
+    // std140 blocks shared by all programs, packed by snapshot()
+    UniformBuffer m_camera_ubo;
+    UniformBuffer m_lights_ubo;
+    // forward+ light lists, see useTiledLighting; null while every light
+    // is declared in the shaders
+    std::unique_ptr<tiles::LightGrid> m_light_grid;
+    // deferred path, see useDeferredShading; null : lit while drawn
+    std::unique_ptr<deferred::Renderer> m_deferred;
+
+    // object versions at the time of the last upload (0 : never uploaded)
+    unsigned long              m_camera_version { 0 };
+    std::vector<unsigned long> m_light_versions;
+
+    void uploadCamera(const frame::FramePacket&);
+    void uploadLights(const frame::FramePacket&);
+
+    // all geometry lives in one arena : one vao, no rebinding between draws
+    GeometryArena m_arena;
+    // geometry -> (arena handle, geometry revision at upload)
+    std::unordered_map<const Geometry*, std::pair<unsigned int, unsigned int>>
+      m_resident;
+
+    auto resident(const Geometry*) -> unsigned int;
+
+    // meshes sharing geometry and material state, drawn with one call
+    struct Batch {
+      const Geometry*          geometry;
+      unsigned int             handle;
+      unsigned int             revision;
+      Material*                material;
+      std::vector<const Mesh*> meshes;
+      // refreshed every frame by collectInstances
+      std::size_t              first_instance;
+      std::size_t              instance_count;
+      float                    depth;
+      // visible instances per level of detail, stored level by level
+      std::vector<std::size_t> lod_counts;
+      // occlusion query slot of an expensive mesh, NoQuery otherwise
+      unsigned int             query;
+    };
+
+    std::vector<Batch>        m_batches;
+    bool                      m_batches_dirty { true };
+    std::vector<Instance>     m_instances;
+    unsigned int              m_instance_vbo;
+    std::size_t               m_instance_capacity { 0 };
+    std::shared_ptr<Geometry> m_light_geometry;
+
+    // hierarchy over every batched mesh; primitives follow batch order
+    bvh::BVH                   m_bvh;
+    std::vector<const Mesh*>   m_bvh_meshes;
+    // transform revision each primitive box was computed from
+    std::vector<unsigned long> m_bvh_revisions;
+    std::vector<unsigned char> m_visible;
+    // meshes straddling the frustum, retested 4-wide by their spheres
+    bounds::SphereSoA          m_spheres;
+    std::vector<unsigned int>  m_candidates;
+    std::vector<unsigned char> m_candidate_visible;
+
+    // projected error, in pixels, a level of detail may show
+    static constexpr float     LodTolerance { 1.0f };
+    // switching to a coarser level needs this fraction of the tolerance,
+    // so meshes near a threshold do not flicker between levels
+    static constexpr float     LodHysteresis { 0.75f };
+    // level drawn last frame, per primitive
+    std::vector<unsigned char> m_lod_levels;
+    std::vector<unsigned char> m_instance_levels;
+    std::vector<Instance>      m_lod_scratch;
+
+    // meshes rasterized into the software depth buffer, and their
+    // primitives once batched
+    std::vector<const Mesh*>   m_occluders;
+    std::vector<unsigned int>  m_occluder_primitives;
+    std::vector<unsigned char> m_is_occluder;
+    occlusion::OcclusionBuffer m_occlusion;
+
+    void cullOccluded(const frame::FramePacket&);
+
+    // meshes with at least this many indices get a batch of their own,
+    // drawn under a hardware occlusion query on their box
+    static constexpr std::size_t  QueryMinIndices { 1 << 12 };
+    static constexpr unsigned int NoQuery { static_cast<unsigned int>(-1) };
+    ShaderProgram                 m_query_shader;
+    bool                          m_queries_enabled { false };
+    query::OcclusionQueries       m_queries;
+    // primitive of each query slot
+    std::vector<unsigned int>     m_query_primitives;
+
+    void issueQueries(const frame::FramePacket&);
+
+    // merged static meshes, and the meshes they were baked from with
+    // their world bounds, which picking searches instead of the merged ones
+    std::vector<std::unique_ptr<Mesh>> m_baked;
+    std::vector<const Mesh*>           m_static_sources;
+    bvh::BVH                           m_static_bvh;
+    // per primitive of m_bvh : a merged mesh
+    std::vector<unsigned char>         m_is_baked;
+
+    void rebuildBatches(const frame::FramePacket&);
+    auto collectInstances(const frame::FramePacket&) -> bool;
+    void uploadInstances();
+
+    queue::RenderQueue        m_queue;
+    queue::Stats              m_stats;
+    float                     m_time { 0.0f };
+    // batches with at least one visible instance, and their programs
+    std::vector<unsigned int> m_drawn;
+    std::vector<unsigned int> m_drawn_programs;
+
+    // draws the queued batches with or without an occlusion query
+    void submit(bool);
 
     // auxiliary
-    unsigned int             m_light_vao;
     Mesh*                    m_light_mesh { nullptr };
     ShaderProgram            m_light_shader;
     std::vector<Positional*> m_positional_lights;
@@ -37,21 +248,96 @@ namespace api::scene {
     ~Scene();
 
     void addMesh(Mesh*);
+    // marks an added mesh as an occluder for software occlusion culling;
+    // large, simple, opaque meshes (walls, terrain) work best
+    void addOccluder(Mesh*);
     void addLightMesh(Mesh*);
     void addMaterial(Material*);
     void addLight(LightSource*);
     void addShader(const std::string&, const std::filesystem::path&);
     void addLightShader(const std::filesystem::path&);
+    // enables occlusion queries, reading the bounding box shader
+    void addQueryShader(const std::filesystem::path&);
+
+    /*
+     * merges every mesh marked static, pre-transformed to world space,
+     * into one mesh per material and cell of a grid with the given cell
+     * size; the cells keep culling effective. the sources stay owned by
+     * the caller but are no longer drawn, and picking still returns them
+     */
+    void bakeStatic(float chunk = 16.0f);
 
+    // keeps linked program binaries in the given directory; needs a
+    // current context and takes effect for the next compileShaders
+    void useProgramCache(const std::filesystem::path&);
+    // rebuilds every variant in the background when a .in or .glsl file
+    // in the directory changes, keeping the old programs if that fails
+    void watchShaders(const std::filesystem::path&);
+    // forward+ : lights live in texture buffers and fragments only loop over
+    // those binned into their screen tile, so lights come and go without
+    // recompiling; needs a current context and takes effect for the next
+    // configureShaders
+    void useTiledLighting();
+    /*
+     * deferred : materials fill a g-buffer, then every light shades only
+     * the pixels its volume covers, reading the pass shaders from the
+     * directory; replaces tiled lighting. needs a current context and
+     * takes effect for the next configureShaders
+     */
+    void useDeferredShading(const std::filesystem::path&);
     void configureShaders();
     void compileShaders();
 
-    void render(unsigned int, float) const;
+    /*
+     * snapshot runs on the simulation thread and only reads scene objects;
+     * render runs on the thread owning the gl context and only reads the
+     * packet, so the two may overlap as long as the scene layout (meshes,
+     * materials, lights) is fixed
+     */
+    void snapshot(frame::FramePacket&, float) const;
+    void render(const frame::FramePacket&, unsigned int);
     void renderLights() const;
 
     [[nodiscard]]
     auto material(unsigned int m) -> Material*;
 
+    // closest mesh whose bounds are hit by a ray, nullptr on a miss;
+    // bounds are those of the last rendered frame (render thread only)
+    [[nodiscard]]
+    auto pick(const vec_t&, const vec_t&, float) const -> const Mesh*;
+    // mesh whose bounds are closest to a point, with the distance to them;
+    // a null mesh when the scene is empty
+    [[nodiscard]]
+    auto nearest(const vec_t&) const -> Hit;
+
+    [[nodiscard]]
+    auto meshes() const -> const std::vector<Mesh*>& {
+      return m_meshes;
+    }
+
+    [[nodiscard]]
+    auto materials() const -> const std::vector<Material*>& {
+      return m_materials;
+    }
+
+    [[nodiscard]]
+    auto lights() const -> const std::vector<LightSource*>& {
+      return m_lights;
+    }
+
+    // one of the meshes addLight attaches to a light to show it
+    [[nodiscard]]
+    auto isLightMarker(const Mesh* mesh) const -> bool {
+      return m_light_geometry != nullptr &&
+             mesh->geometry() == m_light_geometry;
+    }
+
+    // state changes issued and avoided during the last frame
+    [[nodiscard]]
+    auto stats() const -> const queue::Stats& {
+      return m_stats;
+    }
+
     void print() const;
   };
 
@@ -1,20 +1,40 @@
 #include "shader.h"
 
 #include "utils/error.h"
+#include "utils/hash.h"
 #include "utils/log.h"
 
 #include <glad/gl.h>
 
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>
+
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include <fstream>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+  #define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 namespace api::shader {
   using namespace utils;
 
+  namespace {
+    // completion can be polled without blocking; needs a current context
+    auto parallelCompile() -> bool {
+      static const auto supported =
+        glfwExtensionSupported("GL_KHR_parallel_shader_compile") ||
+        glfwExtensionSupported("GL_ARB_parallel_shader_compile");
+      return supported;
+    }
+  } // namespace
+
   template <GLenum S>
   Shader<S>::Shader(const std::string& label)
     : m_label { label }
@@ -22,13 +42,13 @@ namespace api::shader {
 
   template <GLenum S>
   Shader<S>::~Shader() {
-    if (is_compiled()) {
-      glDeleteShader(id());
-    }
+    // created up front : never compiled (a program loaded from the cache)
+    // or failed shaders own it too
+    glDeleteShader(id());
   }
 
   template <GLenum S>
-  void Shader<S>::set(const std::string& key, std::any value) {
+  void Shader<S>::assign(const std::string& key, std::any value) {
     if (key == "compiled") {
       m_compiled = std::any_cast<bool>(value);
     } else {
@@ -67,6 +87,43 @@ namespace api::shader {
     }
     m_source_in = shader_src;
     m_source    = shader_src;
+    m_hash      = hash::fnv1a(m_source);
+    set("compiled", false);
+  }
+
+  template <GLenum S>
+  void Shader<S>::reset(std::string source) {
+    m_source_in = std::move(source);
+    m_source    = m_source_in;
+    m_hash      = hash::fnv1a(m_source);
+    set("compiled", false);
+  }
+
+  template <GLenum S>
+  void Shader<S>::preprocess(preprocess::Preprocessor&       preprocessor,
+                             const std::vector<std::string>& defines) {
+    m_hash = preprocessor.run(m_source_in,
+                              m_source_in_fname,
+                              defines,
+                              m_source);
+    set("compiled", false);
+  }
+
+  template <GLenum S>
+  void Shader<S>::derive(const Shader&      base,
+                         std::string        source,
+                         std::uint64_t      hash,
+                         const std::string& suffix) {
+    m_source_in = base.m_source_in;
+    m_source    = std::move(source);
+    m_hash      = hash;
+    // name.frag.in -> name.suffix.frag.in
+    m_source_in_fname = base.m_source_in_fname;
+    const auto dot    = m_source_in_fname.find('.',
+                                            m_source_in_fname.rfind('/') + 1);
+    if (dot != std::string::npos && !suffix.empty()) {
+      m_source_in_fname.insert(dot, "." + suffix);
+    }
     set("compiled", false);
   }
 
@@ -91,16 +148,6 @@ namespace api::shader {
     }
   }
 
-  template <GLenum S>
-  void Shader<S>::replaceString(const std::string& str,
-                                const std::string& newstr) {
-    size_t pos = m_source.find(str);
-    if (pos == std::string::npos) {
-      raise::error(str + " not found in shader source");
-    }
-    m_source.replace(pos, str.size(), newstr);
-  }
-
   template <GLenum S>
   void Shader<S>::compile(bool errorIfCompiled) {
     if (is_compiled() && errorIfCompiled) {
@@ -128,6 +175,32 @@ namespace api::shader {
     set("compiled", true);
   }
 
+  template <GLenum S>
+  void Shader<S>::submit() {
+    if (m_source.empty()) {
+      raise::error("shader source empty");
+    }
+    const auto src_c = m_source.c_str();
+    glShaderSource(id(), 1, &src_c, nullptr);
+    glCompileShader(id());
+  }
+
+  template <GLenum S>
+  auto Shader<S>::finish() -> bool {
+    int success;
+    glGetShaderiv(id(), GL_COMPILE_STATUS, &success);
+    if (!success) {
+      char infoLog[512];
+      glGetShaderInfoLog(id(), 512, nullptr, infoLog);
+      log::log(log::ERROR,
+               label() + " shader compilation failed : " +
+                 std::string(infoLog));
+      return false;
+    }
+    set("compiled", true);
+    return true;
+  }
+
   ShaderProgram::ShaderProgram(const std::string& label)
     : m_label { label }
     , m_id { glCreateProgram() }
@@ -135,12 +208,11 @@ namespace api::shader {
     , m_fragmentShader { label + " fragment" } {}
 
   ShaderProgram::~ShaderProgram() {
-    if (is_linked()) {
-      glDeleteProgram(id());
-    }
+    // created up front : failed and never linked programs own it too
+    glDeleteProgram(id());
   }
 
-  void ShaderProgram::set(const std::string& key, std::any value) {
+  void ShaderProgram::assign(const std::string& key, std::any value) {
     if (key == "linked") {
       m_linked = std::any_cast<bool>(value);
     } else if (key == "compiled") {
@@ -158,6 +230,12 @@ namespace api::shader {
     set("linked", false);
   }
 
+  void ShaderProgram::preprocess(preprocess::Preprocessor& preprocessor) {
+    m_vertexShader.preprocess(preprocessor);
+    m_fragmentShader.preprocess(preprocessor);
+    set("linked", false);
+  }
+
   void ShaderProgram::compile(bool errorIfCompiled) {
     m_vertexShader.compile(errorIfCompiled);
     m_fragmentShader.compile(errorIfCompiled);
@@ -186,6 +264,101 @@ namespace api::shader {
       log::log(log::SUCCESS, label() + " program linked successfully");
     }
     m_linked = true;
+    cacheUniformLocations();
+    // linking resets all uniform values
+    m_synced_versions.clear();
+  }
+
+  void ShaderProgram::build(const cache::ProgramCache* cache) {
+    if (is_linked()) {
+      raise::error("shader program already linked");
+    }
+    if (cache == nullptr || !cache->supported()) {
+      compile();
+      link();
+      return;
+    }
+    const auto key = cache->key(m_vertexShader.hash(),
+                                m_fragmentShader.hash());
+    if (loadCached(*cache, key)) {
+      return;
+    }
+    compile();
+    cache->prepare(id());
+    link();
+    cache->store(id(), key);
+  }
+
+  auto ShaderProgram::loadCached(const cache::ProgramCache& cache,
+                                 std::uint64_t              key) -> bool {
+    if (!cache.load(id(), key)) {
+      return false;
+    }
+    log::log(log::SUCCESS, label() + " program loaded from cache");
+    m_linked = true;
+    cacheUniformLocations();
+    m_synced_versions.clear();
+    return true;
+  }
+
+  void ShaderProgram::submit(const cache::ProgramCache* cache) {
+    if (is_linked()) {
+      raise::error("shader program already linked");
+    }
+    const auto cached = cache != nullptr && cache->supported();
+    if (cached && loadCached(*cache,
+                             cache->key(m_vertexShader.hash(),
+                                        m_fragmentShader.hash()))) {
+      return;
+    }
+    m_vertexShader.submit();
+    m_fragmentShader.submit();
+    glAttachShader(id(), m_vertexShader.id());
+    glAttachShader(id(), m_fragmentShader.id());
+    if (cached) {
+      cache->prepare(id());
+    }
+    glLinkProgram(id());
+  }
+
+  auto ShaderProgram::ready() const -> bool {
+    if (is_linked() || !parallelCompile()) {
+      return true;
+    }
+    int done = 0;
+    glGetProgramiv(id(), GL_COMPLETION_STATUS_KHR, &done);
+    return done != 0;
+  }
+
+  auto ShaderProgram::finish(const cache::ProgramCache* cache) -> bool {
+    if (is_linked()) {
+      // loaded from the cache, or shared and finished already
+      return true;
+    }
+    // both shaders are checked so every error gets logged
+    const auto vertex   = m_vertexShader.finish();
+    const auto fragment = m_fragmentShader.finish();
+    if (!vertex || !fragment) {
+      return false;
+    }
+    int success;
+    glGetProgramiv(id(), GL_LINK_STATUS, &success);
+    if (!success) {
+      char infoLog[512];
+      glGetProgramInfoLog(id(), 512, nullptr, infoLog);
+      log::log(log::ERROR,
+               label() + " program link failed : " + std::string(infoLog));
+      return false;
+    }
+    log::log(log::SUCCESS, label() + " program linked successfully");
+    m_linked = true;
+    cacheUniformLocations();
+    m_synced_versions.clear();
+    if (cache != nullptr && cache->supported()) {
+      cache->store(id(),
+                   cache->key(m_vertexShader.hash(), m_fragmentShader.hash()));
+    }
+    return true;
   }
 
   void ShaderProgram::use() const {
@@ -196,29 +369,98 @@ namespace api::shader {
     }
   }
 
+  auto ShaderProgram::isSynced(const Object& object) const -> bool {
+    const auto it = m_synced_versions.find(&object);
+    return it != m_synced_versions.end() && it->second == object.version();
+  }
+
+  void ShaderProgram::markSynced(const Object& object) const {
+    m_synced_versions[&object] = object.version();
+  }
+
+  void ShaderProgram::bindUniformBlock(const std::string& block,
+                                       unsigned int       binding) const {
+    const auto index = glGetUniformBlockIndex(id(), block.c_str());
+    if (index == GL_INVALID_INDEX) {
+      log::log(log::DEBUG, label() + " : no active uniform block " + block);
+    } else {
+      glUniformBlockBinding(id(), index, binding);
+    }
+  }
+
+  void ShaderProgram::cacheUniformLocations() {
+    m_uniform_locations.clear();
+    int n_uniforms = 0, max_length = 0;
+    glGetProgramiv(id(), GL_ACTIVE_UNIFORMS, &n_uniforms);
+    glGetProgramiv(id(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::string buffer(max_length, '\0');
+    for (auto u = 0; u < n_uniforms; ++u) {
+      GLsizei length = 0;
+      GLint   size   = 0;
+      GLenum  type   = 0;
+      glGetActiveUniform(id(),
+                         u,
+                         max_length,
+                         &length,
+                         &size,
+                         &type,
+                         &buffer[0]);
+      const auto name     = buffer.substr(0, length);
+      const auto location = glGetUniformLocation(id(), name.c_str());
+      if (location < 0) {
+        // members of uniform blocks have no location
+        continue;
+      }
+      m_uniform_locations[name] = location;
+      // arrays of basic types are reported once as `name[0]`
+      if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+        const auto base          = name.substr(0, name.size() - 3);
+        m_uniform_locations[base] = location;
+        for (auto i = 1; i < size; ++i) {
+          const auto element = base + "[" + std::to_string(i) + "]";
+          m_uniform_locations[element] = glGetUniformLocation(id(),
+                                                              element.c_str());
+        }
+      }
+    }
+    log::log(log::DEBUG,
+             label() + " : cached " +
+               std::to_string(m_uniform_locations.size()) +
+               " uniform locations");
+  }
+
+  auto ShaderProgram::uniformLocation(const std::string& name) const -> int {
+    const auto it = m_uniform_locations.find(name);
+    if (it == m_uniform_locations.end()) {
+      // same as glGetUniformLocation : -1 is silently ignored by glUniform*
+      return -1;
+    }
+    return it->second;
+  }
+
   void ShaderProgram::setUniform1f(const std::string& name, float value) const {
     log::log(log::DEBUG,
              "setting uniform " + name + " to " + std::to_string(value));
-    glUniform1f(glGetUniformLocation(id(), name.c_str()), value);
+    setUniform1f(uniformLocation(name), value);
   }
 
   void ShaderProgram::setUniform1i(const std::string& name, int value) const {
     log::log(log::DEBUG,
              "setting uniform " + name + " to " + std::to_string(value));
-    glUniform1i(glGetUniformLocation(id(), name.c_str()), value);
+    setUniform1i(uniformLocation(name), value);
   }
 
   void ShaderProgram::setUniform1ui(const std::string& name,
                                     unsigned int       value) const {
     log::log(log::DEBUG,
              "setting uniform " + name + " to " + std::to_string(value));
-    glUniform1ui(glGetUniformLocation(id(), name.c_str()), value);
+    setUniform1ui(uniformLocation(name), value);
   }
 
   void ShaderProgram::setUniform1b(const std::string& name, bool value) const {
     log::log(log::DEBUG,
              "setting uniform " + name + " to " + std::to_string(value));
-    glUniform1i(glGetUniformLocation(id(), name.c_str()), value);
+    setUniform1b(uniformLocation(name), value);
   }
 
   void ShaderProgram::setUniform3fv(const std::string& name,
@@ -226,17 +468,38 @@ namespace api::shader {
     log::log(log::DEBUG,
              "setting uniform " + name + " to " + std::to_string(value.x) +
                " " + std::to_string(value.y) + " " + std::to_string(value.z));
-    glUniform3fv(glGetUniformLocation(id(), name.c_str()),
-                 1,
-                 glm::value_ptr(value));
+    setUniform3fv(uniformLocation(name), value);
   }
 
   void ShaderProgram::setUniformMatrix4fv(const std::string& name,
                                           const glm::mat4&   value) const {
-    glUniformMatrix4fv(glGetUniformLocation(id(), name.c_str()),
-                       1,
-                       GL_FALSE,
-                       glm::value_ptr(value));
+    setUniformMatrix4fv(uniformLocation(name), value);
+  }
+
+  void ShaderProgram::setUniform1f(int location, float value) const {
+    glUniform1f(location, value);
+  }
+
+  void ShaderProgram::setUniform1i(int location, int value) const {
+    glUniform1i(location, value);
+  }
+
+  void ShaderProgram::setUniform1ui(int location, unsigned int value) const {
+    glUniform1ui(location, value);
+  }
+
+  void ShaderProgram::setUniform1b(int location, bool value) const {
+    glUniform1i(location, value);
+  }
+
+  void ShaderProgram::setUniform3fv(int              location,
+                                    const glm::vec3& value) const {
+    glUniform3fv(location, 1, glm::value_ptr(value));
+  }
+
+  void ShaderProgram::setUniformMatrix4fv(int              location,
+                                          const glm::mat4& value) const {
+    glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
   }
 
   void ShaderProgram::print() const {
@@ -1,14 +1,19 @@
 #ifndef API_SHADER_H
 #define API_SHADER_H
 
+#include "api/cache.h"
 #include "api/object.h"
+#include "api/preprocess.h"
 
 #include <glad/gl.h>
 
 #include <glm/glm.hpp>
 
 #include <any>
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace api::shader {
   using namespace api::object;
@@ -20,17 +25,35 @@ namespace api::shader {
     std::string        m_source;
     std::string        m_source_in { "" };
     std::string        m_source_in_fname;
+    // content hash of m_source
+    std::uint64_t      m_hash { 0 };
     bool               m_compiled { false };
 
   public:
     Shader(const std::string&);
     ~Shader();
 
+    Shader(const Shader&) = delete;
+
     void readShaderFromPath(const std::string&);
+    // replaces the file source, e.g. after the file changed on disk
+    void reset(std::string);
+    // expands the file source into the compiled source
+    void preprocess(preprocess::Preprocessor&,
+                    const std::vector<std::string>& defines = {});
+    // takes the file of another shader with a source already expanded from
+    // it; the dump file name gets `suffix`
+    void derive(const Shader&,
+                std::string        source,
+                std::uint64_t      hash,
+                const std::string& suffix);
     void saveShaderSource() const;
-    void replaceString(const std::string&, const std::string&);
     void compile(bool = true);
-    void set(const std::string&, std::any) override;
+    // compile without waiting; finish reports the result, which blocks
+    // unless the driver says the compile completed
+    void submit();
+    auto finish() -> bool;
+    void assign(const std::string&, std::any) override;
 
     void recompile() {
       compile(false);
@@ -48,15 +71,25 @@ namespace api::shader {
     }
 
     [[nodiscard]]
-    auto source() const -> std::string {
+    auto source() const -> const std::string& {
       return m_source;
     }
 
     [[nodiscard]]
-    auto source_in() const -> std::string {
+    auto source_in() const -> const std::string& {
       return m_source_in;
     }
 
+    [[nodiscard]]
+    auto path() const -> const std::string& {
+      return m_source_in_fname;
+    }
+
+    [[nodiscard]]
+    auto hash() const -> std::uint64_t {
+      return m_hash;
+    }
+
     [[nodiscard]]
     auto is_compiled() const -> bool {
       return m_compiled;
@@ -70,11 +103,23 @@ namespace api::shader {
     Shader<GL_VERTEX_SHADER>   m_vertexShader;
     Shader<GL_FRAGMENT_SHADER> m_fragmentShader;
 
+    // uniform locations resolved once at link time
+    std::unordered_map<std::string, int> m_uniform_locations;
+
+    // versions of the objects whose uniforms are current in this program
+    mutable std::unordered_map<const Object*, unsigned long> m_synced_versions;
+
+    void cacheUniformLocations();
+    auto loadCached(const cache::ProgramCache&, std::uint64_t) -> bool;
+
   public:
     ShaderProgram(const std::string&);
     ~ShaderProgram();
 
+    ShaderProgram(const ShaderProgram&) = delete;
+
     void readShadersFromPaths(const std::string&, const std::string&);
+    void preprocess(preprocess::Preprocessor&);
 
     void compile(bool = true);
 
@@ -88,11 +133,36 @@ namespace api::shader {
       link(false);
     }
 
+    // links from the program cache when it holds the current sources,
+    // otherwise compiles, links and stores the result
+    void build(const cache::ProgramCache* = nullptr);
+
+    /*
+     * asynchronous build : submit queues compile and link, or links at once
+     * from the program cache; ready polls GL_COMPLETION_STATUS_KHR (always
+     * true without parallel compile support), finish checks the outcome,
+     * stores it in the cache and logs errors instead of raising so a failed
+     * build can simply be dropped. both take the same cache
+     */
+    void submit(const cache::ProgramCache* = nullptr);
+    [[nodiscard]]
+    auto ready() const -> bool;
+    auto finish(const cache::ProgramCache* = nullptr) -> bool;
+
     void use() const;
+
+    [[nodiscard]]
+    auto isSynced(const Object&) const -> bool;
+    void markSynced(const Object&) const;
+
+    void bindUniformBlock(const std::string&, unsigned int) const;
     void print() const;
-    void set(const std::string&, std::any) override;
+    void assign(const std::string&, std::any) override;
 
     // uniforms
+    [[nodiscard]]
+    auto uniformLocation(const std::string&) const -> int;
+
     void setUniform1f(const std::string&, float) const;
     void setUniform1i(const std::string&, int) const;
     void setUniform1ui(const std::string&, unsigned int) const;
@@ -100,6 +170,14 @@ namespace api::shader {
     void setUniform3fv(const std::string&, const glm::vec3&) const;
     void setUniformMatrix4fv(const std::string&, const glm::mat4&) const;
 
+    // uniforms by pre-resolved location (see uniformLocation)
+    void setUniform1f(int, float) const;
+    void setUniform1i(int, int) const;
+    void setUniform1ui(int, unsigned int) const;
+    void setUniform1b(int, bool) const;
+    void setUniform3fv(int, const glm::vec3&) const;
+    void setUniformMatrix4fv(int, const glm::mat4&) const;
+
     // accessors
     [[nodiscard]]
     auto id() const -> unsigned int {
@@ -125,6 +203,16 @@ namespace api::shader {
     auto fragmentShader() -> Shader<GL_FRAGMENT_SHADER>& {
       return m_fragmentShader;
     }
+
+    [[nodiscard]]
+    auto vertexShader() const -> const Shader<GL_VERTEX_SHADER>& {
+      return m_vertexShader;
+    }
+
+    [[nodiscard]]
+    auto fragmentShader() const -> const Shader<GL_FRAGMENT_SHADER>& {
+      return m_fragmentShader;
+    }
   };
 
 } // namespace api::shader
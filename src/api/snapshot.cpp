@@ -0,0 +1,538 @@
+#include "snapshot.h"
+
+#include "api/arena.h"
+#include "api/bounds.h"
+#include "api/camera.h"
+#include "api/texture.h"
+#include "api/transform.h"
+#include "utils/error.h"
+#include "utils/log.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <type_traits>
+
+namespace api::snapshot {
+  using namespace utils;
+
+  static_assert(std::is_trivially_copyable_v<Header>);
+  static_assert(std::is_trivially_copyable_v<GeometryRecord>);
+  static_assert(std::is_trivially_copyable_v<MeshRecord>);
+  static_assert(std::is_trivially_copyable_v<MaterialRecord>);
+  static_assert(std::is_trivially_copyable_v<LightRecord>);
+
+  namespace {
+    constexpr std::uint64_t Alignment { 16 };
+
+    auto align(std::uint64_t offset) -> std::uint64_t {
+      return (offset + Alignment - 1) / Alignment * Alignment;
+    }
+
+    void put(float* out, const glm::vec3& v) {
+      out[0] = v.x;
+      out[1] = v.y;
+      out[2] = v.z;
+    }
+
+    auto get(const float* in) -> glm::vec3 {
+      return { in[0], in[1], in[2] };
+    }
+
+    // nul-terminated strings, deduplicated
+    class Strings {
+      std::string                          m_blob;
+      std::map<std::string, std::uint32_t> m_offsets;
+
+    public:
+      auto add(const std::string& s) -> std::uint32_t {
+        const auto found = m_offsets.find(s);
+        if (found != m_offsets.end()) {
+          return found->second;
+        }
+        const auto offset = static_cast<std::uint32_t>(m_blob.size());
+        m_blob.append(s).push_back('\0');
+        m_offsets.emplace(s, offset);
+        return offset;
+      }
+
+      [[nodiscard]]
+      auto blob() const -> const std::string& {
+        return m_blob;
+      }
+    };
+
+    auto texturePath(const texture::Texture* t, Strings& strings)
+      -> std::uint32_t {
+      return t == nullptr ? None : strings.add(t->path());
+    }
+  } // namespace
+
+  void save(const std::filesystem::path& path, const scene::Scene& scene) {
+    const auto& transforms = transform::store();
+    Strings     strings;
+
+    std::vector<GeometryRecord>                         geometries;
+    std::vector<const geometry::Geometry*>              sources;
+    std::map<const geometry::Geometry*, std::uint32_t> geometry_index;
+    std::vector<MaterialRecord>                         materials;
+    std::map<const material::Material*, std::uint32_t> material_index;
+    std::vector<MeshRecord>                             meshes;
+    std::vector<LightRecord>                            lights;
+
+    const auto addGeometry = [&](const geometry::Geometry& g) {
+      const auto found = geometry_index.find(&g);
+      if (found != geometry_index.end()) {
+        return found->second;
+      }
+      if (g.gpuVertices().empty()) {
+        raise::error("geometry has no gpu streams, regenerate its buffers "
+                     "before saving: " +
+                     g.name());
+      }
+      if (g.lods().size() > MaxLods) {
+        raise::error("too many lod levels to save: " + g.name());
+      }
+      GeometryRecord record {};
+      record.name         = strings.add(g.name());
+      record.lod_count    = static_cast<std::uint32_t>(g.lods().size());
+      record.vertex_count = g.gpuVertices().size();
+      record.index_count  = g.gpuIndices().size();
+      put(record.aabb_min, g.aabb().min);
+      put(record.aabb_max, g.aabb().max);
+      put(record.sphere, g.sphere().center);
+      record.sphere[3] = g.sphere().radius;
+      for (auto l = std::size_t { 0 }; l < g.lods().size(); ++l) {
+        const auto& lod      = g.lods()[l];
+        record.lods[l].first = static_cast<std::uint32_t>(lod.first);
+        record.lods[l].count = static_cast<std::uint32_t>(lod.count);
+        record.lods[l].error = lod.error;
+      }
+      const auto index = static_cast<std::uint32_t>(geometries.size());
+      geometries.push_back(record);
+      sources.push_back(&g);
+      geometry_index.emplace(&g, index);
+      return index;
+    };
+
+    const auto addMaterial = [&](const material::Material* m) {
+      if (m == nullptr) {
+        return None;
+      }
+      const auto found = material_index.find(m);
+      if (found != material_index.end()) {
+        return found->second;
+      }
+      MaterialRecord record {};
+      record.name             = strings.add(m->name());
+      record.type             = static_cast<std::uint32_t>(m->type());
+      record.diffuse_texture  = None;
+      record.specular_texture = None;
+      if (const auto* normal = dynamic_cast<const material::Normal*>(m)) {
+        record.shininess = normal->shininess();
+        record.diffuse_texture =
+          texturePath(normal->diffuseTexture(), strings);
+        record.specular_texture =
+          texturePath(normal->specularTexture(), strings);
+      } else if (const auto* emitter =
+                   dynamic_cast<const material::Emitter*>(m)) {
+        put(record.color, emitter->color());
+      }
+      const auto index = static_cast<std::uint32_t>(materials.size());
+      materials.push_back(record);
+      material_index.emplace(m, index);
+      return index;
+    };
+
+    std::vector<const mesh::Mesh*>               saved;
+    std::map<transform::handle_t, std::uint32_t> mesh_index;
+    for (const auto* mesh : scene.meshes()) {
+      if (scene.isLightMarker(mesh)) {
+        continue;
+      }
+      mesh_index.emplace(mesh->node(),
+                         static_cast<std::uint32_t>(saved.size()));
+      saved.push_back(mesh);
+    }
+    for (const auto* mesh : saved) {
+      MeshRecord record {};
+      record.name     = strings.add(mesh->name());
+      record.geometry = addGeometry(*mesh->geometry());
+      record.material = addMaterial(mesh->material());
+      record.flags    = mesh->isStatic() ? MeshRecord::Static : 0u;
+      record.parent   = None;
+
+      const auto parent = transforms.parent(mesh->node());
+      if (parent != transform::npos) {
+        const auto found = mesh_index.find(parent);
+        if (found != mesh_index.end()) {
+          record.parent = found->second;
+        } else {
+          log::log(log::WARNING,
+                   "mesh " + mesh->name() +
+                     " is attached to a node outside the scene, saved "
+                     "relative to the origin");
+        }
+      }
+      put(record.position, transforms.position(mesh->node()));
+      const auto& q      = transforms.rotation(mesh->node());
+      record.rotation[0] = q.w;
+      record.rotation[1] = q.x;
+      record.rotation[2] = q.y;
+      record.rotation[3] = q.z;
+      put(record.scale, transforms.scale(mesh->node()));
+      meshes.push_back(record);
+    }
+
+    for (const auto* light : scene.lights()) {
+      LightRecord record {};
+      record.type = static_cast<std::uint32_t>(light->type());
+      put(record.ambient_color, light->ambientColor());
+      put(record.diffuse_color, light->diffuseColor());
+      put(record.specular_color, light->specularColor());
+      record.ambient_strength  = light->ambientStrength();
+      record.diffuse_strength  = light->diffuseStrength();
+      record.specular_strength = light->specularStrength();
+      if (const auto* p = dynamic_cast<const light::Positional*>(light)) {
+        put(record.position, p->position());
+        record.constant  = p->constant();
+        record.linear    = p->linear();
+        record.quadratic = p->quadratic();
+      }
+      if (const auto* d = dynamic_cast<const light::Directional*>(light)) {
+        put(record.direction, d->direction());
+      }
+      if (const auto* s = dynamic_cast<const light::Spotlight*>(light)) {
+        record.cutoff       = s->cutoff();
+        record.outer_cutoff = s->outerCutoff();
+      }
+      lights.push_back(record);
+    }
+
+    Header header {};
+    header.magic           = Magic;
+    header.version         = Version;
+    header.geometry_count  = static_cast<std::uint32_t>(geometries.size());
+    header.mesh_count      = static_cast<std::uint32_t>(meshes.size());
+    header.material_count  = static_cast<std::uint32_t>(materials.size());
+    header.light_count     = static_cast<std::uint32_t>(lights.size());
+    header.geometry_offset = align(sizeof(Header));
+    header.mesh_offset     = align(header.geometry_offset +
+                               geometries.size() * sizeof(GeometryRecord));
+    header.material_offset = align(header.mesh_offset +
+                                   meshes.size() * sizeof(MeshRecord));
+    header.light_offset    = align(header.material_offset +
+                                materials.size() * sizeof(MaterialRecord));
+    header.strings_offset  = align(header.light_offset +
+                                  lights.size() * sizeof(LightRecord));
+    header.strings_size    = strings.blob().size();
+
+    const auto& camera    = scene.camera;
+    header.camera.type    = static_cast<std::uint32_t>(camera.type());
+    put(header.camera.position, camera.position());
+    header.camera.fov    = camera.fov();
+    header.camera.aspect = camera.aspect();
+    header.camera.znear  = camera.zNear();
+    header.camera.zfar   = camera.zFar();
+    header.camera.yaw    = camera.yaw();
+    header.camera.pitch  = camera.pitch();
+    header.camera.roll   = camera.roll();
+
+    // streams go last, each on its own boundary
+    auto end = align(header.strings_offset + header.strings_size);
+    for (auto& record : geometries) {
+      record.vertex_offset = end;
+      end = align(end + record.vertex_count * sizeof(float));
+      record.index_offset = end;
+      end = align(end + record.index_count * sizeof(unsigned int));
+    }
+
+    std::vector<char> file(end, 0);
+    const auto write = [&](std::uint64_t offset, const void* data,
+                           std::size_t size) {
+      if (size > 0) {
+        std::memcpy(file.data() + offset, data, size);
+      }
+    };
+    write(0, &header, sizeof(header));
+    write(header.geometry_offset,
+          geometries.data(),
+          geometries.size() * sizeof(GeometryRecord));
+    write(header.mesh_offset,
+          meshes.data(),
+          meshes.size() * sizeof(MeshRecord));
+    write(header.material_offset,
+          materials.data(),
+          materials.size() * sizeof(MaterialRecord));
+    write(header.light_offset,
+          lights.data(),
+          lights.size() * sizeof(LightRecord));
+    write(header.strings_offset, strings.blob().data(), header.strings_size);
+    for (auto g = std::size_t { 0 }; g < geometries.size(); ++g) {
+      const auto vertices = sources[g]->gpuVertices();
+      const auto indices  = sources[g]->gpuIndices();
+      write(geometries[g].vertex_offset,
+            vertices.data(),
+            vertices.size() * sizeof(float));
+      write(geometries[g].index_offset,
+            indices.data(),
+            indices.size() * sizeof(unsigned int));
+    }
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      raise::error("failed to open " + path.generic_string());
+    }
+    out.write(file.data(), static_cast<std::streamsize>(file.size()));
+    if (!out) {
+      raise::error("failed to write " + path.generic_string());
+    }
+    log::log(log::INFO,
+             "saved scene snapshot " + path.generic_string() + " (" +
+               std::to_string(file.size()) + " bytes)");
+  }
+
+  Snapshot::Snapshot(const std::filesystem::path& path)
+    : m_file { std::make_shared<const mapped::MappedFile>(path) } {
+    m_header = *at<Header>(0, 1);
+    if (m_header.magic != Magic) {
+      raise::error("not a scene snapshot: " + path.generic_string());
+    }
+    if (m_header.version != Version) {
+      raise::error("unsupported scene snapshot version " +
+                   std::to_string(m_header.version) + ": " +
+                   path.generic_string());
+    }
+    // the string section must end with a terminator for string() to be safe
+    const auto* strings = at<char>(m_header.strings_offset,
+                                   m_header.strings_size);
+    if (m_header.strings_size > 0 &&
+        strings[m_header.strings_size - 1] != '\0') {
+      raise::error("scene snapshot string section is corrupt");
+    }
+    loadGeometries();
+    loadMaterials();
+    loadLights();
+    loadMeshes();
+    log::log(log::INFO,
+             "mapped scene snapshot " + path.generic_string() + " (" +
+               std::to_string(m_meshes.size()) + " meshes)");
+  }
+
+  template <typename T>
+  auto Snapshot::at(std::uint64_t offset, std::uint64_t count) const
+    -> const T* {
+    const auto size = static_cast<std::uint64_t>(m_file->size());
+    if (offset % alignof(T) != 0 || offset > size ||
+        count > (size - offset) / sizeof(T)) {
+      raise::error("scene snapshot is truncated or corrupt");
+    }
+    return reinterpret_cast<const T*>(
+      static_cast<const char*>(m_file->data()) + offset);
+  }
+
+  auto Snapshot::string(std::uint32_t offset) const -> std::string {
+    if (offset == None) {
+      return "";
+    }
+    if (offset >= m_header.strings_size) {
+      raise::error("scene snapshot string reference is out of range");
+    }
+    return at<char>(m_header.strings_offset, m_header.strings_size) + offset;
+  }
+
+  void Snapshot::loadGeometries() {
+    const auto* records = at<GeometryRecord>(m_header.geometry_offset,
+                                             m_header.geometry_count);
+    for (auto g = 0u; g < m_header.geometry_count; ++g) {
+      const auto& record = records[g];
+      if (record.lod_count == 0 || record.lod_count > MaxLods) {
+        raise::error("scene snapshot geometry has invalid lods");
+      }
+      if (record.vertex_count % arena::VertexStride != 0) {
+        raise::error("scene snapshot vertex stream is not whole vertices");
+      }
+      // every index reaches the gpu as is : one past the end is a fetch
+      // out of the arena
+      const auto* indices  = at<unsigned int>(record.index_offset,
+                                              record.index_count);
+      const auto  vertices = record.vertex_count / arena::VertexStride;
+      if (std::any_of(indices,
+                      indices + record.index_count,
+                      [&](unsigned int i) { return i >= vertices; })) {
+        raise::error("scene snapshot index is out of range");
+      }
+      std::vector<geometry::Lod> lods;
+      for (auto l = 0u; l < record.lod_count; ++l) {
+        const auto& lod = record.lods[l];
+        if (std::uint64_t { lod.first } + lod.count > record.index_count) {
+          raise::error("scene snapshot lod is out of range");
+        }
+        lods.push_back({ lod.first, lod.count, lod.error });
+      }
+      bounds::AABB box;
+      box.min = get(record.aabb_min);
+      box.max = get(record.aabb_max);
+      bounds::Sphere sphere;
+      sphere.center = get(record.sphere);
+      sphere.radius = record.sphere[3];
+      m_geometries.push_back(std::make_shared<geometry::Geometry>(
+        string(record.name),
+        m_file,
+        mapped::View<float>(
+          at<float>(record.vertex_offset, record.vertex_count),
+          record.vertex_count),
+        mapped::View<unsigned int>(indices, record.index_count),
+        lods,
+        box,
+        sphere));
+    }
+  }
+
+  void Snapshot::loadMaterials() {
+    const auto* records = at<MaterialRecord>(m_header.material_offset,
+                                             m_header.material_count);
+    for (auto m = 0u; m < m_header.material_count; ++m) {
+      const auto& record = records[m];
+      const auto  name   = string(record.name);
+      switch (static_cast<material::MaterialType>(record.type)) {
+        case material::MaterialType::Default: {
+          config_t params { { "shininess", record.shininess } };
+          if (record.diffuse_texture != None) {
+            params["diffuseTexture"] =
+              std::filesystem::path(string(record.diffuse_texture));
+          }
+          if (record.specular_texture != None) {
+            params["specularTexture"] =
+              std::filesystem::path(string(record.specular_texture));
+          }
+          m_defaults.push_back(
+            std::make_unique<material::Default>(name, params));
+          m_materials.push_back(m_defaults.back().get());
+          break;
+        }
+        case material::MaterialType::Emitter:
+          m_emitters.push_back(std::make_unique<material::Emitter>(
+            name,
+            config_t {
+              { "color", get(record.color) }
+          }));
+          m_materials.push_back(m_emitters.back().get());
+          break;
+        default:
+          raise::error("scene snapshot has an unknown material type");
+      }
+    }
+  }
+
+  void Snapshot::loadLights() {
+    const auto* records = at<LightRecord>(m_header.light_offset,
+                                          m_header.light_count);
+    for (auto l = 0u; l < m_header.light_count; ++l) {
+      const auto& record = records[l];
+      config_t    params {
+        {    "ambientColor",    get(record.ambient_color)},
+        {    "diffuseColor",    get(record.diffuse_color)},
+        {   "specularColor",   get(record.specular_color)},
+        { "ambientStrength",      record.ambient_strength},
+        { "diffuseStrength",      record.diffuse_strength},
+        {"specularStrength",     record.specular_strength}
+      };
+      const auto positional = [&] {
+        params["position"]  = get(record.position);
+        params["constant"]  = record.constant;
+        params["linear"]    = record.linear;
+        params["quadratic"] = record.quadratic;
+      };
+      switch (static_cast<light::LightType>(record.type)) {
+        case light::LightType::Distant:
+          params["direction"] = get(record.direction);
+          m_distants.push_back(std::make_unique<light::Distant>(params));
+          m_lights.push_back(m_distants.back().get());
+          break;
+        case light::LightType::Point:
+          positional();
+          m_points.push_back(std::make_unique<light::Point>(params));
+          m_lights.push_back(m_points.back().get());
+          break;
+        case light::LightType::Spotlight:
+          positional();
+          params["direction"]   = get(record.direction);
+          params["cutoff"]      = record.cutoff;
+          params["outerCutoff"] = record.outer_cutoff;
+          m_spotlights.push_back(std::make_unique<light::Spotlight>(params));
+          m_lights.push_back(m_spotlights.back().get());
+          break;
+        default:
+          raise::error("scene snapshot has an unknown light type");
+      }
+    }
+  }
+
+  void Snapshot::loadMeshes() {
+    const auto* records = at<MeshRecord>(m_header.mesh_offset,
+                                         m_header.mesh_count);
+    for (auto m = 0u; m < m_header.mesh_count; ++m) {
+      const auto& record = records[m];
+      if (record.geometry >= m_geometries.size() ||
+          (record.material != None && record.material >= m_materials.size())) {
+        raise::error("scene snapshot mesh reference is out of range");
+      }
+      m_meshes.push_back(std::make_unique<mesh::Mesh>(
+        string(record.name), m_geometries[record.geometry]));
+      auto& mesh = *m_meshes.back();
+      const auto rotation = glm::quat(record.rotation[0],
+                                      record.rotation[1],
+                                      record.rotation[2],
+                                      record.rotation[3]);
+      mesh.configure({
+        {"position",                  get(record.position)},
+        {"rotation",                              rotation},
+        {   "scale",                     get(record.scale)},
+        {  "static", (record.flags & MeshRecord::Static) != 0}
+      });
+      if (record.material != None) {
+        mesh.attachMaterial(m_materials[record.material]);
+      }
+    }
+    // parents may come after their children in the file
+    for (auto m = 0u; m < m_header.mesh_count; ++m) {
+      const auto parent = records[m].parent;
+      if (parent == None) {
+        continue;
+      }
+      if (parent >= m_header.mesh_count || parent == m) {
+        raise::error("scene snapshot mesh parent is out of range");
+      }
+      m_meshes[m]->attachTo(m_meshes[parent]->node());
+    }
+  }
+
+  void Snapshot::populate(scene::Scene& scene) const {
+    for (auto* material : m_materials) {
+      scene.addMaterial(material);
+    }
+    for (const auto& mesh : m_meshes) {
+      scene.addMesh(mesh.get());
+    }
+    for (auto* light : m_lights) {
+      scene.addLight(light);
+    }
+    const auto& camera = m_header.camera;
+    scene.camera.configure({
+      {    "type", static_cast<camera::CameraType>(camera.type)},
+      {"position",                     get(camera.position)},
+      {     "fov",                               camera.fov},
+      {  "aspect",                            camera.aspect},
+      {   "zNear",                             camera.znear},
+      {    "zFar",                              camera.zfar},
+      {     "yaw",                               camera.yaw},
+      {   "pitch",                             camera.pitch},
+      {    "roll",                              camera.roll}
+    });
+  }
+
+} // namespace api::snapshot
@@ -0,0 +1,164 @@
+#ifndef API_SNAPSHOT_H
+#define API_SNAPSHOT_H
+
+#include "global.h"
+
+#include "api/geometry.h"
+#include "api/light.h"
+#include "api/material.h"
+#include "api/mesh.h"
+#include "api/scene.h"
+#include "utils/mapped.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace api::snapshot {
+
+  // "ESNP", little endian
+  static constexpr std::uint32_t Magic { 0x504E5345 };
+  // bumped on every layout change; older files are rejected, not migrated
+  static constexpr std::uint32_t Version { 2 };
+  static constexpr std::uint32_t MaxLods { 8 };
+  // absent string, material or light reference
+  static constexpr std::uint32_t None { 0xFFFFFFFF };
+
+  /*
+   * file layout, every section starting on a 16 byte boundary :
+   *
+   *   Header | GeometryRecord[] | MeshRecord[] | MaterialRecord[] |
+   *   LightRecord[] | strings | vertex and index streams
+   *
+   * offsets count from the start of the file; strings are nul-terminated
+   * and referenced by their offset into the string section. vertex streams
+   * are the interleaved gpu-ready layout of Geometry, so they are uploaded
+   * from the mapping without any conversion
+   */
+  struct CameraRecord {
+    std::uint32_t type;
+    float         position[3];
+    float         fov, aspect, znear, zfar;
+    float         yaw, pitch, roll;
+  };
+
+  struct Header {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t geometry_count;
+    std::uint32_t mesh_count;
+    std::uint32_t material_count;
+    std::uint32_t light_count;
+    std::uint64_t geometry_offset;
+    std::uint64_t mesh_offset;
+    std::uint64_t material_offset;
+    std::uint64_t light_offset;
+    std::uint64_t strings_offset;
+    std::uint64_t strings_size;
+    CameraRecord  camera;
+  };
+
+  struct LodRecord {
+    std::uint32_t first;
+    std::uint32_t count;
+    float         error;
+  };
+
+  struct GeometryRecord {
+    std::uint32_t name;
+    std::uint32_t lod_count;
+    std::uint64_t vertex_offset;
+    std::uint64_t vertex_count;
+    std::uint64_t index_offset;
+    std::uint64_t index_count;
+    float         aabb_min[3], aabb_max[3];
+    float         sphere[4];
+    LodRecord     lods[MaxLods];
+  };
+
+  struct MeshRecord {
+    static constexpr std::uint32_t Static { 1u << 0 };
+
+    std::uint32_t name;
+    std::uint32_t geometry;
+    std::uint32_t material;
+    std::uint32_t flags;
+    // index of the parent mesh record, None for roots; the transform
+    // below is relative to the parent
+    std::uint32_t parent;
+    float         position[3];
+    // w, x, y, z
+    float         rotation[4];
+    float         scale[3];
+  };
+
+  struct MaterialRecord {
+    std::uint32_t name;
+    std::uint32_t type;
+    std::uint32_t diffuse_texture;
+    std::uint32_t specular_texture;
+    float         shininess;
+    float         color[3];
+  };
+
+  struct LightRecord {
+    std::uint32_t type;
+    float         ambient_color[3], diffuse_color[3], specular_color[3];
+    float         ambient_strength, diffuse_strength, specular_strength;
+    float         position[3];
+    float         constant, linear, quadratic;
+    float         direction[3];
+    float         cutoff, outer_cutoff;
+  };
+
+  // writes the camera, the lights and every mesh of a scene with their
+  // hierarchy, geometries and materials; the markers the scene attaches
+  // to its lights are recreated by addLight and are skipped
+  void save(const std::filesystem::path&, const scene::Scene&);
+
+  /*
+   * scene content loaded from a snapshot file; geometry streams stay in
+   * the mapping and are uploaded from it directly, textures are decoded
+   * from their referenced paths. everything populated into a scene is
+   * owned here and must outlive it
+   */
+  class Snapshot {
+    std::shared_ptr<const utils::mapped::MappedFile> m_file;
+
+    Header                                           m_header;
+    std::vector<std::shared_ptr<geometry::Geometry>> m_geometries;
+    std::vector<std::unique_ptr<material::Default>>  m_defaults;
+    std::vector<std::unique_ptr<material::Emitter>>  m_emitters;
+    // in file order, pointing into the typed lists above
+    std::vector<material::Material*>                 m_materials;
+    std::vector<std::unique_ptr<light::Point>>       m_points;
+    std::vector<std::unique_ptr<light::Distant>>     m_distants;
+    std::vector<std::unique_ptr<light::Spotlight>>   m_spotlights;
+    std::vector<light::LightSource*>                 m_lights;
+    std::vector<std::unique_ptr<mesh::Mesh>>         m_meshes;
+
+    // bounds-checked pointer to `count` records at `offset`
+    template <typename T>
+    auto at(std::uint64_t offset, std::uint64_t count) const -> const T*;
+    auto string(std::uint32_t) const -> std::string;
+
+    void loadGeometries();
+    void loadMaterials();
+    void loadLights();
+    void loadMeshes();
+
+  public:
+    explicit Snapshot(const std::filesystem::path&);
+
+    Snapshot(const Snapshot&) = delete;
+
+    // adds the materials, meshes and lights and sets up the camera
+    void populate(scene::Scene&) const;
+  };
+
+} // namespace api::snapshot
+
+#endif // API_SNAPSHOT_H
@@ -32,6 +32,7 @@ namespace api::texture {
       m_texture_generated = false;
     }
     glGenTextures(1, &m_texture);
+    m_path = path;
 
     int width, height, channels;
     stbi_set_flip_vertically_on_load(true);
@@ -5,10 +5,11 @@
 
 namespace api::texture {
 
-  static unsigned int TextureId { 0 };
+  inline unsigned int TextureId { 0 };
 
   class Texture {
     const unsigned int m_id;
+    std::string        m_path;
     unsigned int       m_texture;
     bool               m_texture_generated { false };
 
@@ -27,6 +28,12 @@ namespace api::texture {
       return m_id;
     }
 
+    // image the texture was last generated from
+    [[nodiscard]]
+    auto path() const -> const std::string& {
+      return m_path;
+    }
+
     [[nodiscard]]
     auto texture() const -> unsigned int {
       return m_texture;
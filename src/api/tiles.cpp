@@ -0,0 +1,189 @@
+#include "tiles.h"
+
+#include "api/bounds.h"
+#include "utils/jobs.h"
+
+#include <glad/gl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace api::tiles {
+  using namespace utils;
+
+  namespace {
+    constexpr GLenum Formats[] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+
+    const auto Empty = glm::ivec4(0, 0, -1, -1);
+
+    void fill(unsigned int buffer, const void* data, std::size_t bytes) {
+      glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+      // fresh storage every time : draws of the previous frame may still
+      // read the old contents
+      glBufferData(GL_TEXTURE_BUFFER,
+                   static_cast<GLsizeiptr>(bytes),
+                   data,
+                   GL_STREAM_DRAW);
+      glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // tiles covered by the screen rectangle of a light's sphere
+    auto rectangle(const light::PackedLight& light,
+                   const bounds::Frustum&    frustum,
+                   const transform_t&        view_projection,
+                   int                       width,
+                   int                       height) -> glm::ivec4 {
+      const auto columns = (width + LightGrid::TileSize - 1) /
+                           LightGrid::TileSize;
+      const auto rows = (height + LightGrid::TileSize - 1) /
+                        LightGrid::TileSize;
+      const auto all    = glm::ivec4(0, 0, columns - 1, rows - 1);
+      const auto center = vec_t(light.position);
+      const auto radius = light.position.w;
+      if (!frustum.intersects(bounds::Sphere { center, radius })) {
+        return Empty;
+      }
+      if (radius == light::Unbounded) {
+        return all;
+      }
+      // corners of the sphere's box; one behind the eye covers everything
+      auto low  = glm::vec2(1.0f);
+      auto high = glm::vec2(-1.0f);
+      for (auto c = 0u; c < 8; ++c) {
+        const auto corner = center + radius * vec_t((c & 1) ? 1.0f : -1.0f,
+                                                     (c & 2) ? 1.0f : -1.0f,
+                                                     (c & 4) ? 1.0f : -1.0f);
+        const auto clip = view_projection * glm::vec4(corner, 1.0f);
+        if (clip.w <= 0.0f) {
+          return all;
+        }
+        const auto ndc = glm::vec2(clip) / clip.w;
+        low            = glm::min(low, ndc);
+        high           = glm::max(high, ndc);
+      }
+      const auto tile = [&](float ndc, int pixels, int last) {
+        const auto p = (ndc * 0.5f + 0.5f) * static_cast<float>(pixels);
+        return std::clamp(static_cast<int>(std::floor(p)) /
+                            LightGrid::TileSize,
+                          0,
+                          last);
+      };
+      return { tile(low.x, width, columns - 1),
+               tile(low.y, height, rows - 1),
+               tile(high.x, width, columns - 1),
+               tile(high.y, height, rows - 1) };
+    }
+  } // namespace
+
+  LightGrid::LightGrid() {
+    glGenBuffers(Buffers, m_buffers);
+    glGenTextures(Buffers, m_textures);
+    for (auto b = 0u; b < Buffers; ++b) {
+      fill(m_buffers[b], nullptr, 0);
+      glBindTexture(GL_TEXTURE_BUFFER, m_textures[b]);
+      glTexBuffer(GL_TEXTURE_BUFFER, Formats[b], m_buffers[b]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+  }
+
+  LightGrid::~LightGrid() {
+    glDeleteTextures(Buffers, m_textures);
+    glDeleteBuffers(Buffers, m_buffers);
+  }
+
+  void LightGrid::upload(const std::vector<light::PackedLight>& lights) {
+    fill(m_buffers[Lights],
+         lights.data(),
+         lights.size() * sizeof(light::PackedLight));
+  }
+
+  void LightGrid::build(const frame::FramePacket& packet) {
+    m_columns = (packet.width + TileSize - 1) / TileSize;
+    m_rows    = (packet.height + TileSize - 1) / TileSize;
+    m_distant = packet.distant_lights;
+    // minimized window : no tiles, and rectangle would clamp to -1
+    if (m_columns == 0 || m_rows == 0) {
+      m_rects.clear();
+      m_tiles.clear();
+      m_indices.clear();
+      fill(m_buffers[Tiles], nullptr, 0);
+      fill(m_buffers[Indices], nullptr, 0);
+      return;
+    }
+
+    const auto& lights = packet.packed_lights;
+    const auto  first  = static_cast<std::size_t>(m_distant);
+    m_rects.resize(lights.size() - first);
+    const bounds::Frustum frustum { packet.view_projection };
+    const auto            rects = [&](std::size_t begin, std::size_t end) {
+      for (auto l = begin; l < end; ++l) {
+        m_rects[l] = rectangle(lights[first + l],
+                               frustum,
+                               packet.view_projection,
+                               packet.width,
+                               packet.height);
+      }
+    };
+    jobs::pool().parallelFor(0, m_rects.size(), 64, rects);
+
+    // counting sort of (tile, light) pairs : counts, offsets, then indices
+    m_tiles.assign(2 * static_cast<std::size_t>(m_columns * m_rows), 0);
+    for (const auto& r : m_rects) {
+      for (auto y = r.y; y <= r.w; ++y) {
+        for (auto x = r.x; x <= r.z; ++x) {
+          ++m_tiles[2 * (y * m_columns + x) + 1];
+        }
+      }
+    }
+    auto total = 0u;
+    m_cursors.resize(m_tiles.size() / 2);
+    for (auto t = std::size_t { 0 }; t < m_cursors.size(); ++t) {
+      m_tiles[2 * t] = total;
+      m_cursors[t]   = total;
+      total         += m_tiles[2 * t + 1];
+    }
+    m_indices.resize(total);
+    for (auto l = std::size_t { 0 }; l < m_rects.size(); ++l) {
+      const auto& r = m_rects[l];
+      for (auto y = r.y; y <= r.w; ++y) {
+        for (auto x = r.x; x <= r.z; ++x) {
+          m_indices[m_cursors[y * m_columns + x]++] =
+            static_cast<unsigned int>(first + l);
+        }
+      }
+    }
+
+    fill(m_buffers[Tiles],
+         m_tiles.data(),
+         m_tiles.size() * sizeof(unsigned int));
+    fill(m_buffers[Indices],
+         m_indices.data(),
+         m_indices.size() * sizeof(unsigned int));
+  }
+
+  void LightGrid::bind() const {
+    for (auto b = 0u; b < Buffers; ++b) {
+      glActiveTexture(GL_TEXTURE0 + FirstUnit + b);
+      glBindTexture(GL_TEXTURE_BUFFER, m_textures[b]);
+    }
+    glActiveTexture(GL_TEXTURE0);
+  }
+
+  void LightGrid::setUniforms(const ShaderProgram& shader) const {
+    shader.setUniform1i("lightData", FirstUnit + Lights);
+    shader.setUniform1i("lightTiles", FirstUnit + Tiles);
+    shader.setUniform1i("lightIndices", FirstUnit + Indices);
+    shader.setUniform1i("distantLights", static_cast<int>(m_distant));
+    shader.setUniform1i("tileColumns", m_columns);
+    shader.setUniform1i("tileSize", TileSize);
+  }
+
+  auto shaderCall() -> std::string {
+    return "result += CalcTiledLights(norm, FragPos, viewDir, "
+           "defaultMaterial[MatIdx]);";
+  }
+
+} // namespace api::tiles
@@ -0,0 +1,98 @@
+#ifndef API_TILES_H
+#define API_TILES_H
+
+#include "global.h"
+
+#include "api/frame.h"
+#include "api/shader.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace api::tiles {
+  using namespace api::shader;
+
+  /*
+   * forward+ light lists : the screen is cut into square tiles and every
+   * positional light is binned, on the cpu, into the tiles its sphere of
+   * influence covers once projected; fragments then loop over the lights
+   * of their own tile. lights, per-tile (offset, count) pairs and the
+   * concatenated index lists live in texture buffers, so no shader depends
+   * on the number or kind of lights. distant lights come first in the
+   * light buffer and apply to every tile
+   *
+   * tiles span the whole depth range : gl 3.3 has no compute stage to
+   * reduce a depth prepass per tile
+   */
+  class LightGrid {
+  public:
+    static constexpr int          TileSize { 16 };
+    // texture units of the light, tile and index buffers; materials keep
+    // the ones below
+    static constexpr unsigned int FirstUnit { 2 };
+
+  private:
+    enum Buffer : unsigned int {
+      Lights,
+      Tiles,
+      Indices,
+      Buffers
+    };
+
+    unsigned int m_buffers[Buffers];
+    unsigned int m_textures[Buffers];
+
+    int          m_columns { 0 };
+    int          m_rows { 0 };
+    unsigned int m_distant { 0 };
+
+    // tile rectangle (x0, y0, x1, y1) of each positional light, empty
+    // when it lies outside the frustum
+    std::vector<glm::ivec4>   m_rects;
+    // (offset, count) per tile, row by row
+    std::vector<unsigned int> m_tiles;
+    std::vector<unsigned int> m_indices;
+    std::vector<unsigned int> m_cursors;
+
+  public:
+    LightGrid();
+    ~LightGrid();
+
+    LightGrid(const LightGrid&) = delete;
+
+    // whenever any light changed
+    void upload(const std::vector<light::PackedLight>&);
+    // bins the packet's positional lights for its camera and viewport
+    void build(const frame::FramePacket&);
+
+    void bind() const;
+    // samplers and tile layout, for every program switched to
+    void setUniforms(const ShaderProgram&) const;
+
+    // accessors
+    // (tile, light) pairs in the last build
+    [[nodiscard]]
+    auto binned() const -> std::size_t {
+      return m_indices.size();
+    }
+
+    [[nodiscard]]
+    auto columns() const -> int {
+      return m_columns;
+    }
+
+    [[nodiscard]]
+    auto rows() const -> int {
+      return m_rows;
+    }
+  };
+
+  // light_calculations block of the tiled path
+  auto shaderCall() -> std::string;
+
+} // namespace api::tiles
+
+#endif // API_TILES_H
@@ -0,0 +1,208 @@
+#include "transform.h"
+
+#include "utils/error.h"
+#include "utils/jobs.h"
+
+#include <algorithm>
+
+#if defined(__SSE__) || defined(_M_X64)
+  #include <xmmintrin.h>
+  #define TRANSFORM_SSE
+#endif
+
+namespace api::transform {
+  using namespace utils;
+
+  namespace {
+    // translate * rotate * scale without the intermediate matrices
+    auto compose(const vec_t& t, const glm::quat& r, const vec_t& s)
+      -> transform_t {
+      auto m = glm::mat4_cast(r);
+      m[0]  *= s.x;
+      m[1]  *= s.y;
+      m[2]  *= s.z;
+      m[3]   = glm::vec4(t, 1.0f);
+      return m;
+    }
+
+    void multiply(const transform_t& a,
+                  const transform_t& b,
+                  transform_t&       out) {
+#ifdef TRANSFORM_SSE
+      const auto a0 = _mm_loadu_ps(&a[0][0]);
+      const auto a1 = _mm_loadu_ps(&a[1][0]);
+      const auto a2 = _mm_loadu_ps(&a[2][0]);
+      const auto a3 = _mm_loadu_ps(&a[3][0]);
+      for (auto c = 0; c < 4; ++c) {
+        // column c of the product : a weighted by the entries of b[c]
+        auto col = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+        col      = _mm_add_ps(col, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+        col      = _mm_add_ps(col, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+        col      = _mm_add_ps(col, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+        _mm_storeu_ps(&out[c][0], col);
+      }
+#else
+      out = a * b;
+#endif
+    }
+  } // namespace
+
+  auto store() -> TransformStore& {
+    static TransformStore instance;
+    return instance;
+  }
+
+  auto TransformStore::create(handle_t parent) -> handle_t {
+    handle_t h;
+    if (m_free.empty()) {
+      h = static_cast<handle_t>(m_position.size());
+      m_position.emplace_back(0.0f);
+      m_rotation.emplace_back(1.0f, 0.0f, 0.0f, 0.0f);
+      m_scale.emplace_back(1.0f);
+      m_parent.push_back(npos);
+      m_local.emplace_back(1.0f);
+      m_world.emplace_back(1.0f);
+      m_normal.emplace_back(1.0f);
+      m_revision.push_back(0);
+      m_uniform.push_back(1);
+      m_dirty.push_back(1);
+      m_moved.push_back(0);
+      m_live.push_back(1);
+    } else {
+      h = m_free.back();
+      m_free.pop_back();
+      m_position[h] = vec_t(0.0f);
+      m_rotation[h] = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+      m_scale[h]    = vec_t(1.0f);
+      m_parent[h]   = npos;
+      m_dirty[h]    = 1;
+      m_moved[h]    = 0;
+      m_live[h]     = 1;
+    }
+    m_order_dirty = true;
+    if (parent != npos) {
+      setParent(h, parent);
+    }
+    return h;
+  }
+
+  void TransformStore::release(handle_t h) {
+    if (h >= m_live.size() || !m_live[h]) {
+      raise::error("invalid transform handle");
+    }
+    // children of a released node become roots
+    for (auto c = 0u; c < m_parent.size(); ++c) {
+      if (m_live[c] && m_parent[c] == h) {
+        m_parent[c] = npos;
+        m_dirty[c]  = 1;
+      }
+    }
+    m_live[h]     = 0;
+    m_order_dirty = true;
+    m_free.push_back(h);
+  }
+
+  void TransformStore::setPosition(handle_t h, const vec_t& position) {
+    m_position[h] = position;
+    m_dirty[h]    = 1;
+  }
+
+  void TransformStore::setRotation(handle_t h, const glm::quat& rotation) {
+    m_rotation[h] = glm::normalize(rotation);
+    m_dirty[h]    = 1;
+  }
+
+  void TransformStore::setScale(handle_t h, const vec_t& scale) {
+    m_scale[h] = scale;
+    m_dirty[h] = 1;
+  }
+
+  void TransformStore::setParent(handle_t h, handle_t parent) {
+    for (auto p = parent; p != npos; p = m_parent[p]) {
+      if (p == h) {
+        raise::error("transform parent would create a cycle");
+      }
+    }
+    m_parent[h]   = parent;
+    m_dirty[h]    = 1;
+    m_order_dirty = true;
+  }
+
+  void TransformStore::sortOrder() {
+    std::vector<unsigned int> depth(m_parent.size(), 0);
+    m_order.clear();
+    for (auto h = 0u; h < m_parent.size(); ++h) {
+      if (!m_live[h]) {
+        continue;
+      }
+      for (auto p = m_parent[h]; p != npos; p = m_parent[p]) {
+        ++depth[h];
+      }
+      m_order.push_back(h);
+    }
+    std::stable_sort(m_order.begin(), m_order.end(), [&](auto a, auto b) {
+      return depth[a] < depth[b];
+    });
+    m_levels.clear();
+    for (auto i = 0u; i < m_order.size(); ++i) {
+      if (i == 0 || depth[m_order[i]] != depth[m_order[i - 1]]) {
+        m_levels.push_back(i);
+      }
+    }
+    m_levels.push_back(m_order.size());
+    m_order_dirty = false;
+  }
+
+  void TransformStore::update() {
+    if (m_order_dirty) {
+      sortOrder();
+    }
+    auto& jobs = utils::jobs::pool();
+    jobs.parallelFor(0, m_order.size(), 1024, [&](auto first, auto last) {
+      for (auto i = first; i < last; ++i) {
+        const auto h = m_order[i];
+        if (m_dirty[h]) {
+          m_local[h] = compose(m_position[h], m_rotation[h], m_scale[h]);
+        }
+      }
+    });
+    // one depth level at a time : parents are final before their children
+    for (auto l = 0u; l + 1 < m_levels.size(); ++l) {
+      jobs.parallelFor(m_levels[l],
+                       m_levels[l + 1],
+                       512,
+                       [&](auto first, auto last) {
+                         for (auto i = first; i < last; ++i) {
+                           updateWorld(m_order[i]);
+                         }
+                       });
+    }
+  }
+
+  void TransformStore::updateWorld(handle_t h) {
+    // a node moves when its own components or any ancestor changed
+    const auto p = m_parent[h];
+    m_moved[h]   = m_dirty[h] || (p != npos && m_moved[p]);
+    if (!m_moved[h]) {
+      return;
+    }
+    if (p == npos) {
+      m_world[h] = m_local[h];
+    } else {
+      multiply(m_world[p], m_local[h], m_world[h]);
+    }
+    const auto& s      = m_scale[h];
+    const auto  linear = glm::mat3(m_world[h]);
+    m_uniform[h] = s.x == s.y && s.y == s.z && (p == npos || m_uniform[p]);
+    if (m_uniform[h]) {
+      // rotation times a scalar k : the inverse transpose is linear / k^2
+      const auto k2 = glm::dot(linear[0], linear[0]);
+      m_normal[h]   = k2 > 0.0f ? linear * (1.0f / k2) : linear;
+    } else {
+      m_normal[h] = glm::transpose(glm::inverse(linear));
+    }
+    ++m_revision[h];
+    m_dirty[h] = 0;
+  }
+
+} // namespace api::transform
@@ -0,0 +1,129 @@
+#ifndef API_TRANSFORM_H
+#define API_TRANSFORM_H
+
+#include "global.h"
+
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstddef>
+#include <vector>
+
+namespace api::transform {
+
+  using handle_t = unsigned int;
+
+  static constexpr handle_t npos { static_cast<handle_t>(-1) };
+
+  /*
+   * transform components of every node, stored as parallel arrays;
+   * setters only flag a node, update() then recomposes the local matrices
+   * of flagged nodes and the world matrices of their subtrees, parents
+   * always before children
+   */
+  class TransformStore {
+    std::vector<vec_t>     m_position;
+    std::vector<glm::quat> m_rotation;
+    std::vector<vec_t>     m_scale;
+    std::vector<handle_t>  m_parent;
+
+    std::vector<transform_t> m_local;
+    std::vector<transform_t> m_world;
+    std::vector<glm::mat3>   m_normal;
+    // bumped every time the world matrix changes
+    std::vector<unsigned long> m_revision;
+    // scale is uniform along the whole chain to the root
+    std::vector<unsigned char> m_uniform;
+
+    // local components changed since the last update
+    std::vector<unsigned char> m_dirty;
+    // world matrix changed during the last update
+    std::vector<unsigned char> m_moved;
+    std::vector<unsigned char> m_live;
+
+    std::vector<handle_t> m_free;
+    // live nodes sorted by depth, rebuilt when the hierarchy changes;
+    // m_levels[d] is the first entry of depth d in m_order
+    std::vector<handle_t>    m_order;
+    std::vector<std::size_t> m_levels;
+    bool                     m_order_dirty { false };
+
+    void sortOrder();
+    void updateWorld(handle_t);
+
+  public:
+    [[nodiscard]]
+    auto create(handle_t parent = npos) -> handle_t;
+    void release(handle_t);
+
+    void setPosition(handle_t, const vec_t&);
+    void setRotation(handle_t, const glm::quat&);
+    void setScale(handle_t, const vec_t&);
+    void setParent(handle_t, handle_t);
+
+    void update();
+
+    // accessors
+    [[nodiscard]]
+    auto position(handle_t h) const -> const vec_t& {
+      return m_position[h];
+    }
+
+    [[nodiscard]]
+    auto rotation(handle_t h) const -> const glm::quat& {
+      return m_rotation[h];
+    }
+
+    [[nodiscard]]
+    auto scale(handle_t h) const -> const vec_t& {
+      return m_scale[h];
+    }
+
+    [[nodiscard]]
+    auto parent(handle_t h) const -> handle_t {
+      return m_parent[h];
+    }
+
+    [[nodiscard]]
+    auto world(handle_t h) const -> const transform_t& {
+      return m_world[h];
+    }
+
+    // inverse transpose of the world matrix, for normals
+    [[nodiscard]]
+    auto normal(handle_t h) const -> const glm::mat3& {
+      return m_normal[h];
+    }
+
+    [[nodiscard]]
+    auto moved(handle_t h) const -> bool {
+      return m_moved[h] != 0;
+    }
+
+    // whole arrays, indexed by handle, for snapshotting
+    [[nodiscard]]
+    auto worlds() const -> const std::vector<transform_t>& {
+      return m_world;
+    }
+
+    [[nodiscard]]
+    auto normals() const -> const std::vector<glm::mat3>& {
+      return m_normal;
+    }
+
+    [[nodiscard]]
+    auto revisions() const -> const std::vector<unsigned long>& {
+      return m_revision;
+    }
+
+    [[nodiscard]]
+    auto size() const -> std::size_t {
+      return m_order.size();
+    }
+  };
+
+  // nodes of every mesh and light live in one store
+  auto store() -> TransformStore&;
+
+} // namespace api::transform
+
+#endif // API_TRANSFORM_H
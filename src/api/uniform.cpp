@@ -0,0 +1,92 @@
+#include "uniform.h"
+
+#include "utils/log.h"
+
+#include <glad/gl.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace api::uniform {
+  using namespace utils;
+
+  void Std140::align(std::size_t alignment) {
+    const auto padded = (m_data.size() + alignment - 1) / alignment * alignment;
+    m_data.resize(padded, 0);
+  }
+
+  void Std140::write(const void* src, std::size_t size, std::size_t alignment) {
+    align(alignment);
+    const auto offset = m_data.size();
+    m_data.resize(offset + size);
+    std::memcpy(m_data.data() + offset, src, size);
+  }
+
+  void Std140::push(float value) {
+    write(&value, sizeof(float), 4);
+  }
+
+  void Std140::push(int value) {
+    write(&value, sizeof(int), 4);
+  }
+
+  void Std140::push(unsigned int value) {
+    write(&value, sizeof(unsigned int), 4);
+  }
+
+  void Std140::push(const glm::vec3& value) {
+    write(glm::value_ptr(value), 3 * sizeof(float), 16);
+  }
+
+  void Std140::push(const glm::vec4& value) {
+    write(glm::value_ptr(value), 4 * sizeof(float), 16);
+  }
+
+  void Std140::push(const glm::mat4& value) {
+    // column-major : four vec4 columns
+    write(glm::value_ptr(value), 16 * sizeof(float), 16);
+  }
+
+  UniformBuffer::UniformBuffer(const std::string& label, unsigned int binding)
+    : m_label { label }
+    , m_binding { binding } {
+    glGenBuffers(1, &m_ubo);
+    glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_ubo);
+  }
+
+  UniformBuffer::~UniformBuffer() {
+    glDeleteBuffers(1, &m_ubo);
+  }
+
+  void UniformBuffer::upload(const Std140& block) {
+    upload(block, 0, block.size());
+  }
+
+  void UniformBuffer::upload(const Std140& block,
+                             std::size_t   offset,
+                             std::size_t   size) {
+    if (size == 0) {
+      return;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    if (block.size() > m_capacity) {
+      log::log(log::DEBUG,
+               m_label + " : resizing to " + std::to_string(block.size()) +
+                 " bytes");
+      glBufferData(GL_UNIFORM_BUFFER,
+                   block.size(),
+                   block.data(),
+                   GL_DYNAMIC_DRAW);
+      m_capacity = block.size();
+      glBindBufferBase(GL_UNIFORM_BUFFER, m_binding, m_ubo);
+    } else {
+      glBufferSubData(GL_UNIFORM_BUFFER, offset, size, block.data() + offset);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  }
+
+} // namespace api::uniform
@@ -0,0 +1,99 @@
+#ifndef API_UNIFORM_H
+#define API_UNIFORM_H
+
+#include "global.h"
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace api::uniform {
+
+  // binding points shared by every shader program in the scene
+  enum Binding : unsigned int {
+    CameraBinding = 0,
+    LightsBinding = 1,
+  };
+
+  /*
+   * CPU-side staging area for a uniform block with std140 layout
+   * (scalars aligned to 4 bytes, vec3/vec4/mat4 columns and structs to 16)
+   */
+  class Std140 {
+    std::vector<unsigned char> m_data;
+
+    void write(const void*, std::size_t, std::size_t);
+
+  public:
+    void clear() {
+      m_data.clear();
+    }
+
+    void align(std::size_t);
+
+    void push(float);
+    void push(int);
+    void push(unsigned int);
+    void push(const glm::vec3&);
+    void push(const glm::vec4&);
+    void push(const glm::mat4&);
+
+    void beginStruct() {
+      align(16);
+    }
+
+    void endStruct() {
+      align(16);
+    }
+
+    // accessors
+    [[nodiscard]]
+    auto size() const -> std::size_t {
+      return m_data.size();
+    }
+
+    [[nodiscard]]
+    auto data() const -> const unsigned char* {
+      return m_data.data();
+    }
+  };
+
+  class UniformBuffer {
+    const std::string  m_label;
+    const unsigned int m_binding;
+    unsigned int       m_ubo;
+    std::size_t        m_capacity { 0 };
+
+  public:
+    UniformBuffer(const std::string&, unsigned int);
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer&) = delete;
+
+    // uploads the whole block with a single buffer update
+    void upload(const Std140&);
+    // uploads only the [offset, offset + size) byte range of the block
+    void upload(const Std140&, std::size_t, std::size_t);
+
+    // accessors
+    [[nodiscard]]
+    auto label() const -> const std::string& {
+      return m_label;
+    }
+
+    [[nodiscard]]
+    auto binding() const -> unsigned int {
+      return m_binding;
+    }
+
+    [[nodiscard]]
+    auto ubo() const -> unsigned int {
+      return m_ubo;
+    }
+  };
+
+} // namespace api::uniform
+
+#endif // API_UNIFORM_H
@@ -2,10 +2,12 @@
 
 #include "global.h"
 
+#include "api/frame.h"
 #include "api/light.h"
 #include "api/mesh.h"
 #include "api/prefabs.h"
 #include "api/scene.h"
+#include "api/snapshot.h"
 #include "api/window.h"
 #include "utils/log.h"
 #include "utils/paths.h"
@@ -17,15 +19,80 @@
 
 #include <glm/glm.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <optional>
+#include <thread>
+
 namespace engine {
   using namespace utils;
   using namespace api;
 
-  void RenderLoop(float   scale,
-                  int     win_width,
-                  int     win_height,
-                  color_t col_bg,
-                  bool    resizable) {
+  namespace {
+    // built-in scene, used when no snapshot is given or found
+    struct Demo {
+      light::Point     point_light;
+      light::Distant   distant_light;
+      light::Spotlight spot_light;
+      mesh::Mesh       cube;
+
+      Demo(scene::Scene& scene, const std::filesystem::path& exe_path)
+        : point_light({
+            { "position", pos_t(1.5f, 1.5f, 2.0f) * 2.0f },
+            { "ambientStrength", 0.1f },
+            { "diffuseStrength", 0.5f },
+            { "specularStrength", 1.0f },
+            { "specularColor", color_t(1.0f, 0.3f, 0.8f) }
+          })
+        , distant_light({
+            { "direction", pos_t(-0.2f, -1.0f, -0.3f) },
+            { "ambientStrength", 0.0f },
+            { "diffuseStrength", 0.0f },
+            { "specularStrength", 0.7f }
+          })
+        , spot_light({
+            { "ambientStrength", 0.0f },
+            { "diffuseStrength", 1.0f },
+            { "specularStrength", 1.0f },
+            { "diffuseColor", color_t(0.5f, 0.5f, 1.0f) }
+          })
+        , cube("cube", prefabs::Cube()) {
+        scene.camera.configure({
+          { "position", pos_t(1.5f, 1.5f, 2.0f) },
+          { "type", camera::CameraType::Perspective }
+        });
+
+        cube.regenBuffers();
+        cube.generateLods(4);
+
+        scene.addMaterial(new material::Default(
+          "cube material",
+          {
+            {      "shininess",      128.0f                           },
+            { "diffuseTexture", exe_path / "assets" / "container2.png"},
+            {"specularTexture",
+             exe_path / "assets" / "container2_specular.png"          }
+        }));
+        scene.addMesh(&cube);
+        scene.addLightMesh(&cube);
+        scene.addLight(&point_light);
+        scene.addLight(&distant_light);
+        scene.addLight(&spot_light);
+
+        cube.attachMaterial(scene.material(0));
+      }
+    };
+  } // namespace
+
+  void RenderLoop(float                        scale,
+                  int                          win_width,
+                  int                          win_height,
+                  color_t                      col_bg,
+                  bool                         resizable,
+                  const std::filesystem::path& scene_file,
+                  Lighting                     lighting) {
     window::Window window { (int)(win_width * scale / 2.0f),
                             (int)(win_height * scale / 2.0f),
                             "engine_window",
@@ -33,98 +100,132 @@ namespace engine {
                             resizable };
     glfwMakeContextCurrent(window.window());
     gladLoadGL(glfwGetProcAddress);
-    auto framebuffer_size_callback = [](GLFWwindow*, int width, int height) {
-      glViewport(0, 0, width, height);
-    };
-    glfwSetFramebufferSizeCallback(window.window(), framebuffer_size_callback);
     glfwSetInputMode(window.window(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_MULTISAMPLE);
 
+    // hardcoded content, or whatever a snapshot holds; both outlive the
+    // scene that points into them
+    std::optional<snapshot::Snapshot> loaded;
+    std::optional<Demo>               demo;
+
     // scene setup
     scene::Scene scene;
     // shader setup
     const auto   exe_path = path::exeDir();
     scene.addShader("example", exe_path / "shaders");
+    scene.addQueryShader(exe_path / "shaders");
+    scene.useProgramCache(exe_path / "shadercache");
+    scene.watchShaders(exe_path / "shaders");
+
+    if (!scene_file.empty() && std::filesystem::exists(scene_file)) {
+      loaded.emplace(scene_file);
+      loaded->populate(scene);
+    } else {
+      demo.emplace(scene, exe_path);
+      if (!scene_file.empty()) {
+        snapshot::save(scene_file, scene);
+      }
+    }
 
     // camera
-    scene.camera.configure({
-      { "aspect", window.aspect() },
-      { "position", pos_t(1.5f, 1.5f, 2.0f) },
-      { "type", camera::CameraType::Perspective }
-    });
+    scene.camera.set("aspect", window.aspect());
     glfwSetWindowUserPointer(window.window(), &scene.camera);
     glfwSetCursorPosCallback(window.window(),
                              camera::Camera::mouseInputCallback);
 
-    // lights
-    auto point_light   = light::Point({
-      { "position", pos_t(1.5f, 1.5f, 2.0f) * 2.0f },
-      { "ambientStrength", 0.1f },
-      { "diffuseStrength", 0.5f },
-      { "specularStrength", 1.0f },
-      { "specularColor", color_t(1.0f, 0.3f, 0.8f) }
-    });
-    auto distant_light = light::Distant({
-      { "direction", pos_t(-0.2f, -1.0f, -0.3f) },
-      { "ambientStrength", 0.0f },
-      { "diffuseStrength", 0.0f },
-      { "specularStrength", 0.7f }
-    });
-    auto spot_light    = light::Spotlight({
-      { "ambientStrength", 0.0f },
-      { "diffuseStrength", 1.0f },
-      { "specularStrength", 1.0f },
-      { "diffuseColor", color_t(0.5f, 0.5f, 1.0f) }
-    });
-
-    // materials
-
-    // meshes
-    auto cube = mesh::Mesh("cube", prefabs::Cube());
-    cube.regenBuffers();
-
-    scene.addMaterial(new material::Default(
-      "cube material",
-      {
-        {      "shininess",      128.0f                           },
-        { "diffuseTexture", exe_path / "assets" / "container2.png"},
-        {"specularTexture",
-         exe_path / "assets" / "container2_specular.png"          }
-    }));
-    scene.addMesh(&cube);
-    scene.addLightMesh(&cube);
-    scene.addLight(&point_light);
-    scene.addLight(&distant_light);
-    scene.addLight(&spot_light);
-
-    cube.attachMaterial(scene.material(0));
+    // the first spotlight circles the origin
+    light::Spotlight* spot_light = nullptr;
+    for (auto* light : scene.lights()) {
+      if (spot_light == nullptr) {
+        spot_light = dynamic_cast<light::Spotlight*>(light);
+      }
+    }
 
+    if (lighting == Lighting::Tiled) {
+      scene.useTiledLighting();
+    } else if (lighting == Lighting::Deferred) {
+      scene.useDeferredShading(exe_path / "shaders");
+    }
     scene.configureShaders();
     scene.compileShaders();
     scene.print();
 
     log::log(log::INFO, "starting render loop");
 
-    timer::Ticker ticker;
-    while (!window.windowShouldClose()) {
+    // the render thread owns the gl context from here on; this thread
+    // keeps input and simulation and hands frames over as packets
+    frame::TripleBuffer<frame::FramePacket> packets;
+    std::atomic<bool>                       running { true };
+    // anything thrown on the render thread is rethrown here after join
+    std::exception_ptr                      failure;
+    glfwMakeContextCurrent(nullptr);
+    std::thread renderer([&] {
+      glfwMakeContextCurrent(window.window());
+      try {
+        auto last_serial = 0ul;
+        auto width = 0, height = 0;
+        while (running.load(std::memory_order_acquire)) {
+          const auto& packet = packets.acquire();
+          if (packet.serial == last_serial) {
+            std::this_thread::yield();
+            continue;
+          }
+          last_serial = packet.serial;
+          if (packet.width != width || packet.height != height) {
+            width  = packet.width;
+            height = packet.height;
+            glViewport(0, 0, width, height);
+          }
+          window.clear();
+          scene.render(packet, 0);
+          glfwSwapBuffers(window.window());
+        }
+      } catch (...) {
+        failure = std::current_exception();
+        running.store(false, std::memory_order_release);
+      }
+      glfwMakeContextCurrent(nullptr);
+    });
+
+    // simulation ticks at a fixed rate, independent of frame time
+    constexpr auto SimulationStep = std::chrono::microseconds(1000000 / 240);
+    auto           next_step      = std::chrono::steady_clock::now();
+    auto           serial         = 0ul;
+    timer::Ticker  ticker;
+    while (running.load(std::memory_order_acquire) &&
+           !window.windowShouldClose()) {
       ticker.tick();
       const auto new_pos = pos_t(1.0f * glm::cos(ticker.time()),
                                  2.0f,
                                  1.0f * glm::sin(ticker.time()));
-      spot_light.configure({
-        { "position",               new_pos},
-        {"direction", pos_t(0.0f) - new_pos}
-      });
+      if (spot_light != nullptr) {
+        spot_light->configure({
+          { "position",               new_pos},
+          {"direction", pos_t(0.0f) - new_pos}
+        });
+      }
 
       window.processKeyboardInput();
       scene.camera.processKeyboardInput(window.window(), ticker.dt());
 
-      window.clear();
-      scene.render(0, ticker.time());
+      auto& packet  = packets.back();
+      packet.serial = ++serial;
+      glfwGetFramebufferSize(window.window(), &packet.width, &packet.height);
+      scene.snapshot(packet, ticker.time());
+      packets.publish();
 
-      glfwSwapBuffers(window.window());
       glfwPollEvents();
+      next_step += SimulationStep;
+      std::this_thread::sleep_until(next_step);
+    }
+
+    running.store(false, std::memory_order_release);
+    renderer.join();
+    // gl objects are released on this thread as the scene goes out of scope
+    glfwMakeContextCurrent(window.window());
+    if (failure) {
+      std::rethrow_exception(failure);
     }
   }
 
@@ -5,14 +5,29 @@
 
 #include "utils/colors.h"
 
+#include <filesystem>
+
 namespace engine {
   using namespace utils;
 
+  enum class Lighting {
+    // every light evaluated for every fragment drawn
+    Forward,
+    // forward+ : lights culled per screen tile
+    Tiled,
+    // g-buffer and light volumes
+    Deferred
+  };
+
+  // loads the scene from a snapshot file when one exists, otherwise builds
+  // the built-in scene and writes it there
   void RenderLoop(float   = 1.0f,
                   int     = 2560,
                   int     = 1440,
                   color_t = color::Convert::from<color::HEX>("#383838"),
-                  bool    = true);
+                  bool    = true,
+                  const std::filesystem::path& = {},
+                  Lighting                     = Lighting::Forward);
 
 } // namespace engine
 
@@ -1,5 +1,6 @@
 #include "engine/engine.h"
 #include "utils/error.h"
+#include "utils/jobs.h"
 
 #define GLAD_GL_IMPLEMENTATION
 #include <glad/gl.h>
@@ -7,11 +8,37 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
-auto main(int, char**) -> int {
+#include <string>
+
+auto main(int argc, char** argv) -> int {
   using namespace utils;
+  if (argc > 1 && std::string(argv[1]) == "--bench-jobs") {
+    jobs::benchmark();
+    return 0;
+  }
+  // --scene <file> : start from a snapshot, written on first run
+  // --tiled : forward+ light culling instead of one shader call per light
+  // --deferred : g-buffer and light volumes
+  std::string scene_file;
+  auto        lighting = engine::Lighting::Forward;
+  for (auto i = 1; i < argc; ++i) {
+    if (std::string(argv[i]) == "--scene" && i + 1 < argc) {
+      scene_file = argv[i + 1];
+    } else if (std::string(argv[i]) == "--tiled") {
+      lighting = engine::Lighting::Tiled;
+    } else if (std::string(argv[i]) == "--deferred") {
+      lighting = engine::Lighting::Deferred;
+    }
+  }
   if (glfwInit()) {
     try {
-      engine::RenderLoop();
+      engine::RenderLoop(1.0f,
+                         2560,
+                         1440,
+                         color::Convert::from<color::HEX>("#383838"),
+                         true,
+                         scene_file,
+                         lighting);
       glfwTerminate();
     } catch (const std::exception& e) {
       glfwTerminate();
@@ -0,0 +1,50 @@
+#pragma once
+
+// light structs live in the std140 `Lights` block;
+// member order must match LightSource::pack
+struct PointLight {
+  vec3 position;
+
+  float constant;
+  float linear;
+  float quadratic;
+
+  vec3 ambientColor;
+  vec3 diffuseColor;
+  vec3 specularColor;
+
+  float ambientStrength;
+  float diffuseStrength;
+  float specularStrength;
+};
+
+struct DistantLight {
+  vec3 direction;
+
+  vec3 ambientColor;
+  vec3 diffuseColor;
+  vec3 specularColor;
+
+  float ambientStrength;
+  float diffuseStrength;
+  float specularStrength;
+};
+
+struct SpotlightLight {
+  vec3  position;
+  vec3  direction;
+  float cutOff;
+  float outerCutOff;
+
+  float constant;
+  float linear;
+  float quadratic;
+
+  vec3 ambientColor;
+  vec3 diffuseColor;
+  vec3 specularColor;
+
+  float ambientStrength;
+  float diffuseStrength;
+  float specularStrength;
+};
@@ -0,0 +1,43 @@
+#pragma once
+
+// forward+ light lists, filled by tiles::LightGrid; each light is six
+// texels of lightData, laid out as light::PackedLight
+uniform samplerBuffer  lightData;
+// (offset, count) into lightIndices per tile, row by row
+uniform usamplerBuffer lightTiles;
+uniform usamplerBuffer lightIndices;
+// the first lights of lightData, applied everywhere
+uniform int            distantLights;
+uniform int            tileColumns;
+uniform int            tileSize;
+
+struct TiledLight {
+  // xyz, w : radius of influence
+  vec4 position;
+  // xyz, w : constant attenuation
+  vec4 direction;
+  // rgb, w : linear attenuation
+  vec4 ambient;
+  // rgb, w : quadratic attenuation
+  vec4 diffuse;
+  vec4 specular;
+  // cosines of the inner and outer cone
+  vec4 cone;
+};
+
+TiledLight fetchLight(int l) {
+  TiledLight light;
+  light.position  = texelFetch(lightData, 6 * l);
+  light.direction = texelFetch(lightData, 6 * l + 1);
+  light.ambient   = texelFetch(lightData, 6 * l + 2);
+  light.diffuse   = texelFetch(lightData, 6 * l + 3);
+  light.specular  = texelFetch(lightData, 6 * l + 4);
+  light.cone      = texelFetch(lightData, 6 * l + 5);
+  return light;
+}
+
+// (offset, count) of the lights binned into this fragment's tile
+uvec2 tileLights() {
+  ivec2 tile = ivec2(gl_FragCoord.xy) / tileSize;
+  return texelFetch(lightTiles, tile.y * tileColumns + tile.x).rg;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// soft clamp of light sums to [0, 1), sharper as n grows
+float smoothLight(float x, float n) {
+  return x / pow(1.0f + pow(x, n), 1.0f / n);
+}
+
+vec3 smoothLight(vec3 v, float n) {
+  return vec3(smoothLight(v.x, n), smoothLight(v.y, n), smoothLight(v.z, n));
+}
@@ -0,0 +1,90 @@
+#include "freelist.h"
+
+#include "utils/error.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+
+namespace utils::freelist {
+
+  FreeList::FreeList(std::size_t capacity) : m_capacity { capacity } {
+    if (capacity > 0) {
+      m_free[0] = capacity;
+    }
+  }
+
+  auto FreeList::allocate(std::size_t size) -> std::size_t {
+    if (size == 0) {
+      return npos;
+    }
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+      if (it->second >= size) {
+        const auto offset = it->first;
+        const auto left   = it->second - size;
+        m_free.erase(it);
+        if (left > 0) {
+          m_free[offset + size] = left;
+        }
+        return offset;
+      }
+    }
+    return npos;
+  }
+
+  void FreeList::release(std::size_t offset, std::size_t size) {
+    if (size == 0) {
+      return;
+    } else if (offset + size > m_capacity) {
+      raise::error("released block is out of bounds");
+    }
+    auto it = m_free.emplace(offset, size).first;
+    // merge with the following block
+    const auto next = std::next(it);
+    if (next != m_free.end() && it->first + it->second == next->first) {
+      it->second += next->second;
+      m_free.erase(next);
+    }
+    // merge with the preceding block
+    if (it != m_free.begin()) {
+      const auto prev = std::prev(it);
+      if (prev->first + prev->second == it->first) {
+        prev->second += it->second;
+        m_free.erase(it);
+      }
+    }
+  }
+
+  void FreeList::grow(std::size_t capacity) {
+    if (capacity <= m_capacity) {
+      return;
+    }
+    const auto old = m_capacity;
+    m_capacity     = capacity;
+    release(old, capacity - old);
+  }
+
+  void FreeList::reset(std::size_t used) {
+    m_free.clear();
+    if (used < m_capacity) {
+      m_free[used] = m_capacity - used;
+    }
+  }
+
+  auto FreeList::available() const -> std::size_t {
+    std::size_t total = 0;
+    for (const auto& [offset, size] : m_free) {
+      total += size;
+    }
+    return total;
+  }
+
+  auto FreeList::largestBlock() const -> std::size_t {
+    std::size_t largest = 0;
+    for (const auto& [offset, size] : m_free) {
+      largest = std::max(largest, size);
+    }
+    return largest;
+  }
+
+} // namespace utils::freelist
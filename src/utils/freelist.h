@@ -0,0 +1,51 @@
+#ifndef UTILS_FREELIST_H
+#define UTILS_FREELIST_H
+
+#include <cstddef>
+#include <map>
+
+namespace utils::freelist {
+
+  /*
+   * first-fit range allocator over [0, capacity) with coalescing of
+   * adjacent free blocks; units are up to the caller (bytes, vertices, ...)
+   */
+  class FreeList {
+    std::size_t                        m_capacity;
+    std::map<std::size_t, std::size_t> m_free; // offset -> size
+
+  public:
+    static constexpr std::size_t npos { static_cast<std::size_t>(-1) };
+
+    FreeList(std::size_t);
+
+    // returns the offset of the block or npos if no free block is large enough
+    auto allocate(std::size_t) -> std::size_t;
+    void release(std::size_t, std::size_t);
+
+    // extends the capacity; the new space is appended to the free list
+    void grow(std::size_t);
+    // marks [0, used) as allocated and the rest as one free block
+    void reset(std::size_t);
+
+    // accessors
+    [[nodiscard]]
+    auto capacity() const -> std::size_t {
+      return m_capacity;
+    }
+
+    [[nodiscard]]
+    auto available() const -> std::size_t;
+
+    [[nodiscard]]
+    auto largestBlock() const -> std::size_t;
+
+    [[nodiscard]]
+    auto blocks() const -> std::size_t {
+      return m_free.size();
+    }
+  };
+
+} // namespace utils::freelist
+
+#endif // UTILS_FREELIST_H
@@ -0,0 +1,43 @@
+#ifndef UTILS_HASH_H
+#define UTILS_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace utils::hash {
+
+  static constexpr std::uint64_t Seed { 14695981039346656037ull };
+
+  // 64-bit FNV-1a; chain calls by passing the previous result as seed
+  inline auto fnv1a(const void*   data,
+                    std::size_t   size,
+                    std::uint64_t seed = Seed) -> std::uint64_t {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    auto        hash  = seed;
+    for (auto b = std::size_t { 0 }; b < size; ++b) {
+      hash ^= bytes[b];
+      hash *= 1099511628211ull;
+    }
+    return hash;
+  }
+
+  inline auto fnv1a(std::string_view text, std::uint64_t seed = Seed)
+    -> std::uint64_t {
+    return fnv1a(text.data(), text.size(), seed);
+  }
+
+  // fixed-width lowercase hex, for file names
+  inline auto hex(std::uint64_t value) -> std::string {
+    constexpr char Digits[] = "0123456789abcdef";
+    std::string    out(16, '0');
+    for (auto i = 15; i >= 0; --i, value >>= 4) {
+      out[static_cast<std::size_t>(i)] = Digits[value & 0xF];
+    }
+    return out;
+  }
+
+} // namespace utils::hash
+
+#endif // UTILS_HASH_H
@@ -0,0 +1,246 @@
+#include "jobs.h"
+
+#include "utils/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+namespace utils::jobs {
+
+  namespace {
+    // pools are told apart by id : a new pool may reuse an old address
+    std::atomic<unsigned int> s_pools { 0 };
+    // deque owned by the current thread, per pool id
+    thread_local std::vector<std::pair<unsigned int, unsigned int>> t_deques;
+  } // namespace
+
+  void Counter::add(int n) {
+    m_pending.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  auto Counter::done() -> std::vector<std::pair<job_t, Counter*>> {
+    // decremented under the lock : see JobSystem::wait
+    std::vector<std::pair<job_t, Counter*>> released;
+    std::lock_guard<std::mutex>             lock { m_mutex };
+    if (m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      released.swap(m_continuations);
+    }
+    return released;
+  }
+
+  JobSystem::JobSystem(unsigned int threads)
+    : m_id(s_pools.fetch_add(1, std::memory_order_relaxed)) {
+    // at least one worker, or jobs only ever run inside wait
+    threads = std::max(1u, threads);
+    for (auto i = 0u; i < threads + External; ++i) {
+      m_queues.push_back(std::make_unique<Queue>());
+    }
+    for (auto i = 0u; i < threads; ++i) {
+      m_threads.emplace_back([this, i] { work(i); });
+    }
+  }
+
+  JobSystem::~JobSystem() {
+    {
+      std::lock_guard<std::mutex> lock { m_sleep_mutex };
+      m_running = false;
+    }
+    m_wake.notify_all();
+    for (auto& t : m_threads) {
+      t.join();
+    }
+  }
+
+  auto JobSystem::self() -> unsigned int {
+    for (const auto& [id, index] : t_deques) {
+      if (id == m_id) {
+        return index;
+      }
+    }
+    const auto slot  = m_external.fetch_add(1, std::memory_order_relaxed);
+    const auto index = threads() + std::min(slot, External - 1);
+    t_deques.emplace_back(m_id, index);
+    return index;
+  }
+
+  void JobSystem::push(Job job) {
+    auto& queue = *m_queues[self()];
+    {
+      std::lock_guard<std::mutex> lock { queue.mutex };
+      queue.jobs.push_back(std::move(job));
+    }
+    m_queued.fetch_add(1, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> lock { m_sleep_mutex };
+    }
+    m_wake.notify_one();
+  }
+
+  auto JobSystem::pop(unsigned int index, Job& job) -> bool {
+    auto&                       queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock { queue.mutex };
+    if (queue.jobs.empty()) {
+      return false;
+    }
+    // newest first : its data is most likely still in cache
+    job = std::move(queue.jobs.back());
+    queue.jobs.pop_back();
+    m_queued.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  auto JobSystem::steal(unsigned int index, Job& job) -> bool {
+    const auto n = m_queues.size();
+    for (auto k = 1u; k < n; ++k) {
+      auto&                       victim = *m_queues[(index + k) % n];
+      std::lock_guard<std::mutex> lock { victim.mutex };
+      if (!victim.jobs.empty()) {
+        // oldest first : usually the largest remaining piece of work
+        job = std::move(victim.jobs.front());
+        victim.jobs.pop_front();
+        m_queued.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void JobSystem::execute(Job& job) {
+    job.fn();
+    if (job.counter != nullptr) {
+      for (auto& [fn, counter] : job.counter->done()) {
+        push({ std::move(fn), counter });
+      }
+    }
+  }
+
+  void JobSystem::work(unsigned int index) {
+    t_deques.emplace_back(m_id, index);
+    Job job;
+    while (true) {
+      if (pop(index, job) || steal(index, job)) {
+        execute(job);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock { m_sleep_mutex };
+      m_wake.wait(lock, [this] {
+        return !m_running || m_queued.load(std::memory_order_acquire) > 0;
+      });
+      if (!m_running && m_queued.load() == 0) {
+        return;
+      }
+    }
+  }
+
+  void JobSystem::run(job_t fn, Counter& counter) {
+    counter.add(1);
+    push({ std::move(fn), &counter });
+  }
+
+  void JobSystem::then(Counter& dependency, job_t fn, Counter& counter) {
+    counter.add(1);
+    {
+      std::lock_guard<std::mutex> lock { dependency.m_mutex };
+      if (!dependency.finished()) {
+        dependency.m_continuations.emplace_back(std::move(fn), &counter);
+        return;
+      }
+    }
+    push({ std::move(fn), &counter });
+  }
+
+  void JobSystem::wait(Counter& counter) {
+    const auto index = self();
+    Job        job;
+    while (!counter.finished()) {
+      if (pop(index, job) || steal(index, job)) {
+        execute(job);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    // the last job may still hold the lock; the counter can be destroyed
+    // as soon as this returns
+    std::lock_guard<std::mutex> lock { counter.m_mutex };
+  }
+
+  void JobSystem::parallelFor(
+    std::size_t                                          begin,
+    std::size_t                                          end,
+    std::size_t                                          grain,
+    const std::function<void(std::size_t, std::size_t)>& fn) {
+    if (end <= begin) {
+      return;
+    }
+    const auto n = end - begin;
+    if (n <= grain) {
+      fn(begin, end);
+      return;
+    }
+    // a few chunks per thread, the caller included, leave room for
+    // stealing to even out
+    const auto helpers = threads() + 1;
+    const auto chunk   = std::max(grain, (n + 4 * helpers - 1) /
+                                          (4 * helpers));
+    Counter    counter;
+    for (auto first = begin; first < end; first += chunk) {
+      const auto last = std::min(end, first + chunk);
+      run([&fn, first, last] { fn(first, last); }, counter);
+    }
+    wait(counter);
+  }
+
+  auto pool() -> JobSystem& {
+    // the threads that wait on it make up the rest of the hardware
+    static const auto cores = std::thread::hardware_concurrency();
+    static JobSystem  instance { std::max(2u, cores) - 1 };
+    return instance;
+  }
+
+  void benchmark(unsigned int max_threads) {
+    using clock = std::chrono::steady_clock;
+    std::vector<float> data(1 << 20);
+    const auto         load = [&](std::size_t first, std::size_t last) {
+      for (auto i = first; i < last; ++i) {
+        auto x = static_cast<float>(i);
+        for (auto k = 0; k < 16; ++k) {
+          x = std::sqrt(std::abs(std::sin(x) * 1e3f + k));
+        }
+        data[i] = x;
+      }
+    };
+    const auto time = [&](const std::function<void()>& fn) {
+      fn();
+      auto best = 1e30;
+      for (auto rep = 0; rep < 5; ++rep) {
+        const auto start = clock::now();
+        fn();
+        const auto elapsed =
+          std::chrono::duration<double, std::milli>(clock::now() - start);
+        best = std::min(best, elapsed.count());
+      }
+      return best;
+    };
+    // the calling thread helps, so t threads are t - 1 workers
+    const auto baseline = time([&] { load(0, data.size()); });
+    for (auto t = 1u; t <= std::max(1u, max_threads); ++t) {
+      auto best = baseline;
+      if (t > 1) {
+        JobSystem jobs { t - 1 };
+        best = time([&] { jobs.parallelFor(0, data.size(), 4096, load); });
+      }
+      char line[96];
+      snprintf(line,
+               sizeof(line),
+               "jobs benchmark : %2u threads : %8.2f ms : x%.2f",
+               t,
+               best,
+               baseline / best);
+      log::log(log::INFO, std::string(line));
+    }
+  }
+
+} // namespace utils::jobs
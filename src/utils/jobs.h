@@ -0,0 +1,112 @@
+#ifndef UTILS_JOBS_H
+#define UTILS_JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils::jobs {
+
+  using job_t = std::function<void()>;
+
+  class JobSystem;
+
+  /*
+   * number of jobs still outstanding in a group; jobs scheduled with
+   * JobSystem::then start once the counter they depend on drops to zero
+   */
+  class Counter {
+    friend class JobSystem;
+
+    std::atomic<int>                             m_pending { 0 };
+    std::mutex                                   m_mutex;
+    std::vector<std::pair<job_t, Counter*>>      m_continuations;
+
+    void add(int);
+    // returns the continuations released when the count reaches zero
+    auto done() -> std::vector<std::pair<job_t, Counter*>>;
+
+  public:
+    [[nodiscard]]
+    auto finished() const -> bool {
+      return m_pending.load(std::memory_order_acquire) == 0;
+    }
+  };
+
+  /*
+   * fixed pool of workers, each with its own deque : owners push and pop
+   * at the back, idle workers steal from the front of the others; threads
+   * outside the pool claim one of a few extra deques on first use and
+   * help while they wait, so the sim and render threads never pop each
+   * other's work
+   */
+  class JobSystem {
+    struct Job {
+      job_t    fn;
+      Counter* counter;
+    };
+
+    struct Queue {
+      std::mutex      mutex;
+      std::deque<Job> jobs;
+    };
+
+    // external threads past this many share the last extra deque
+    static constexpr unsigned int External { 4 };
+
+    std::vector<std::unique_ptr<Queue>> m_queues;
+    std::vector<std::thread>            m_threads;
+    const unsigned int                  m_id;
+    std::atomic<unsigned int>           m_external { 0 };
+
+    std::atomic<bool>       m_running { true };
+    std::atomic<int>        m_queued { 0 };
+    std::mutex              m_sleep_mutex;
+    std::condition_variable m_wake;
+
+    auto self() -> unsigned int;
+    void push(Job);
+    auto pop(unsigned int, Job&) -> bool;
+    auto steal(unsigned int, Job&) -> bool;
+    void execute(Job&);
+    void work(unsigned int);
+
+  public:
+    explicit JobSystem(unsigned int = std::thread::hardware_concurrency());
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+
+    void run(job_t, Counter&);
+    // schedules a job once every job counted by the dependency finished
+    void then(Counter&, job_t, Counter&);
+    // runs queued jobs on the calling thread until the counter is zero
+    void wait(Counter&);
+
+    // splits [begin, end) into chunks of at least grain elements
+    void parallelFor(std::size_t,
+                     std::size_t,
+                     std::size_t,
+                     const std::function<void(std::size_t, std::size_t)>&);
+
+    [[nodiscard]]
+    auto threads() const -> unsigned int {
+      return static_cast<unsigned int>(m_queues.size()) - External;
+    }
+  };
+
+  // pool shared by the engine, sized to the hardware
+  auto pool() -> JobSystem&;
+
+  // reports parallelFor speedup on a synthetic load at 1..N threads
+  void benchmark(unsigned int = std::thread::hardware_concurrency());
+
+} // namespace utils::jobs
+
+#endif // UTILS_JOBS_H
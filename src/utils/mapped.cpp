@@ -0,0 +1,62 @@
+#include "mapped.h"
+
+#include "utils/error.h"
+
+#include <filesystem>
+#include <string>
+
+#if defined(_MSC_VER)
+  #include <fstream>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace utils::mapped {
+
+  MappedFile::MappedFile(const std::filesystem::path& path) {
+#if defined(_MSC_VER)
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) {
+      raise::error("failed to open " + path.generic_string());
+    }
+    m_buffer.resize(static_cast<std::size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(m_buffer.data(), m_buffer.size());
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#else
+    const auto fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      raise::error("failed to open " + path.generic_string());
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+      close(fd);
+      raise::error("failed to stat " + path.generic_string());
+    }
+    m_size = static_cast<std::size_t>(info.st_size);
+    if (m_size > 0) {
+      const auto data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        close(fd);
+        raise::error("failed to map " + path.generic_string());
+      }
+      m_data = data;
+    }
+    // the mapping keeps its own reference to the file
+    close(fd);
+#endif
+  }
+
+  MappedFile::~MappedFile() {
+#if !defined(_MSC_VER)
+    if (m_data != nullptr) {
+      munmap(const_cast<void*>(m_data), m_size);
+    }
+#endif
+  }
+
+} // namespace utils::mapped
@@ -0,0 +1,88 @@
+#ifndef UTILS_MAPPED_H
+#define UTILS_MAPPED_H
+
+#include <cstddef>
+#include <filesystem>
+#include <vector>
+
+namespace utils::mapped {
+
+  /*
+   * read-only, non-owning view over contiguous elements : a vector, or a
+   * range of a mapped file
+   */
+  template <typename T>
+  class View {
+    const T*    m_data { nullptr };
+    std::size_t m_size { 0 };
+
+  public:
+    View() = default;
+
+    View(const T* data, std::size_t size) : m_data { data }, m_size { size } {}
+
+    View(const std::vector<T>& v) : m_data { v.data() }, m_size { v.size() } {}
+
+    [[nodiscard]]
+    auto data() const -> const T* {
+      return m_data;
+    }
+
+    [[nodiscard]]
+    auto size() const -> std::size_t {
+      return m_size;
+    }
+
+    [[nodiscard]]
+    auto empty() const -> bool {
+      return m_size == 0;
+    }
+
+    [[nodiscard]]
+    auto begin() const -> const T* {
+      return m_data;
+    }
+
+    [[nodiscard]]
+    auto end() const -> const T* {
+      return m_data + m_size;
+    }
+
+    [[nodiscard]]
+    auto operator[](std::size_t i) const -> const T& {
+      return m_data[i];
+    }
+  };
+
+  /*
+   * whole file mapped read-only into memory; pages are loaded by the os on
+   * first access, so nothing is read up front. platforms without mmap fall
+   * back to reading the file into a buffer
+   */
+  class MappedFile {
+    const void* m_data { nullptr };
+    std::size_t m_size { 0 };
+#if defined(_MSC_VER)
+    std::vector<char> m_buffer;
+#endif
+
+  public:
+    explicit MappedFile(const std::filesystem::path&);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+
+    [[nodiscard]]
+    auto data() const -> const void* {
+      return m_data;
+    }
+
+    [[nodiscard]]
+    auto size() const -> std::size_t {
+      return m_size;
+    }
+  };
+
+} // namespace utils::mapped
+
+#endif // UTILS_MAPPED_H
@@ -0,0 +1,515 @@
+#include "meshopt.h"
+
+#include "utils/error.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <numeric>
+#include <queue>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace utils::meshopt {
+
+  namespace {
+    auto hashVertex(const float* v, std::size_t stride) -> std::size_t {
+      // FNV-1a over the raw bytes
+      auto        hash  = std::uint64_t { 14695981039346656037ull };
+      const auto* bytes = reinterpret_cast<const unsigned char*>(v);
+      for (auto b = 0u; b < stride * sizeof(float); ++b) {
+        hash ^= bytes[b];
+        hash *= 1099511628211ull;
+      }
+      return static_cast<std::size_t>(hash);
+    }
+
+    // vertex -> triangles adjacency in compressed (offset + list) form
+    struct Adjacency {
+      std::vector<unsigned int> offsets;
+      std::vector<unsigned int> triangles;
+
+      Adjacency(const std::vector<unsigned int>& indices,
+                std::size_t                      nvertices)
+        : offsets(nvertices + 1, 0)
+        , triangles(indices.size()) {
+        for (const auto i : indices) {
+          ++offsets[i + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        auto fill = std::vector<unsigned int>(offsets.begin(),
+                                              offsets.end() - 1);
+        for (auto i = 0u; i < indices.size(); ++i) {
+          triangles[fill[indices[i]]++] = i / 3;
+        }
+      }
+    };
+
+    // symmetric 4x4 plane quadric plus the total weight of its planes
+    struct Quadric {
+      double a[10] { 0.0 };
+      double weight { 0.0 };
+
+      void addPlane(const double n[3], double d, double w) {
+        const double p[4] = { n[0], n[1], n[2], d };
+        auto         k    = 0;
+        for (auto i = 0; i < 4; ++i) {
+          for (auto j = i; j < 4; ++j) {
+            a[k++] += w * p[i] * p[j];
+          }
+        }
+        weight += w;
+      }
+
+      void add(const Quadric& other) {
+        for (auto k = 0; k < 10; ++k) {
+          a[k] += other.a[k];
+        }
+        weight += other.weight;
+      }
+
+      // weighted sum of squared distances of `v` to the planes
+      auto evaluate(const float* v) const -> double {
+        const double p[4] = { v[0], v[1], v[2], 1.0 };
+        auto         sum  = 0.0;
+        auto         k    = 0;
+        for (auto i = 0; i < 4; ++i) {
+          for (auto j = i; j < 4; ++j) {
+            sum += (i == j ? 1.0 : 2.0) * a[k++] * p[i] * p[j];
+          }
+        }
+        return std::max(sum, 0.0);
+      }
+    };
+
+    void triangleNormal(const float* p0,
+                        const float* p1,
+                        const float* p2,
+                        double       n[3]) {
+      const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+      const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+      n[0]               = e1[1] * e2[2] - e1[2] * e2[1];
+      n[1]               = e1[2] * e2[0] - e1[0] * e2[2];
+      n[2]               = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+  } // namespace
+
+  auto weld(const std::vector<float>& stream, std::size_t stride)
+    -> IndexedStream {
+    if (stride == 0 || stream.size() % stride != 0) {
+      raise::error("vertex stream size is not a multiple of the stride");
+    }
+    const auto nvertices = stream.size() / stride;
+    IndexedStream result;
+    result.indices.reserve(nvertices);
+    result.vertices.reserve(stream.size());
+    std::unordered_multimap<std::size_t, unsigned int> unique;
+    unique.reserve(nvertices);
+    for (auto v = 0u; v < nvertices; ++v) {
+      const auto* vertex = stream.data() + v * stride;
+      const auto  hash   = hashVertex(vertex, stride);
+      auto        index  = static_cast<unsigned int>(-1);
+      const auto  range  = unique.equal_range(hash);
+      for (auto it = range.first; it != range.second; ++it) {
+        if (std::memcmp(result.vertices.data() + it->second * stride,
+                        vertex,
+                        stride * sizeof(float)) == 0) {
+          index = it->second;
+          break;
+        }
+      }
+      if (index == static_cast<unsigned int>(-1)) {
+        index = static_cast<unsigned int>(result.vertices.size() / stride);
+        result.vertices.insert(result.vertices.end(), vertex, vertex + stride);
+        unique.emplace(hash, index);
+      }
+      result.indices.push_back(index);
+    }
+    return result;
+  }
+
+  void optimizeTriangleOrder(std::vector<unsigned int>& indices,
+                             const std::vector<float>&  vertices,
+                             std::size_t                stride,
+                             unsigned int               cache_size) {
+    const auto ntriangles = indices.size() / 3;
+    const auto nvertices  = vertices.size() / stride;
+    if (ntriangles == 0) {
+      return;
+    }
+    const Adjacency adjacency { indices, nvertices };
+
+    // Tipsify : fan around the most recently cached vertex
+    std::vector<unsigned int> live(nvertices, 0);
+    for (auto v = 0u; v < nvertices; ++v) {
+      live[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+    }
+    std::vector<unsigned int> timestamp(nvertices, 0);
+    std::vector<bool>         emitted(ntriangles, false);
+    std::vector<unsigned int> dead_end;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> order;
+    // first triangle of every cluster started after a cache discontinuity
+    std::vector<std::size_t>  cluster_starts { 0 };
+    order.reserve(ntriangles);
+
+    auto time   = cache_size + 1;
+    auto cursor = 0u;
+    auto fan    = 0;
+
+    const auto skipDeadEnd = [&]() -> int {
+      while (!dead_end.empty()) {
+        const auto d = dead_end.back();
+        dead_end.pop_back();
+        if (live[d] > 0) {
+          return static_cast<int>(d);
+        }
+      }
+      while (cursor < nvertices) {
+        if (live[cursor] > 0) {
+          return static_cast<int>(cursor);
+        }
+        ++cursor;
+      }
+      return -1;
+    };
+
+    while (fan >= 0) {
+      candidates.clear();
+      for (auto a = adjacency.offsets[fan]; a < adjacency.offsets[fan + 1];
+           ++a) {
+        const auto t = adjacency.triangles[a];
+        if (emitted[t]) {
+          continue;
+        }
+        for (auto c = 0u; c < 3; ++c) {
+          const auto v = indices[t * 3 + c];
+          dead_end.push_back(v);
+          candidates.push_back(v);
+          --live[v];
+          if (time - timestamp[v] > cache_size) {
+            timestamp[v] = time++;
+          }
+        }
+        emitted[t] = true;
+        order.push_back(t);
+      }
+      // pick the candidate that will still be in the cache after fanning
+      auto next     = -1;
+      auto priority = -1;
+      for (const auto v : candidates) {
+        if (live[v] == 0) {
+          continue;
+        }
+        auto p = 0;
+        if (time - timestamp[v] + 2 * live[v] <= cache_size) {
+          p = static_cast<int>(time - timestamp[v]);
+        }
+        if (p > priority) {
+          priority = p;
+          next     = static_cast<int>(v);
+        }
+      }
+      if (next == -1) {
+        next = skipDeadEnd();
+        if (next >= 0 && order.size() < ntriangles) {
+          cluster_starts.push_back(order.size());
+        }
+      }
+      fan = next;
+    }
+
+    // overdraw : emit clusters facing away from the mesh center first
+    std::vector<float> centroid(3, 0.0f);
+    for (auto v = 0u; v < nvertices; ++v) {
+      for (auto c = 0u; c < 3; ++c) {
+        centroid[c] += vertices[v * stride + c] / nvertices;
+      }
+    }
+    const auto nclusters = cluster_starts.size();
+    cluster_starts.push_back(order.size());
+    std::vector<float> sort_key(nclusters, 0.0f);
+    for (auto k = 0u; k < nclusters; ++k) {
+      float area_sum = 0.0f;
+      float center[3] { 0.0f, 0.0f, 0.0f };
+      float normal[3] { 0.0f, 0.0f, 0.0f };
+      for (auto o = cluster_starts[k]; o < cluster_starts[k + 1]; ++o) {
+        const auto* p0 = vertices.data() + indices[order[o] * 3 + 0] * stride;
+        const auto* p1 = vertices.data() + indices[order[o] * 3 + 1] * stride;
+        const auto* p2 = vertices.data() + indices[order[o] * 3 + 2] * stride;
+        const float e1[3] { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        const float e2[3] { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        const float n[3] { e1[1] * e2[2] - e1[2] * e2[1],
+                           e1[2] * e2[0] - e1[0] * e2[2],
+                           e1[0] * e2[1] - e1[1] * e2[0] };
+        const auto  area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (auto c = 0u; c < 3; ++c) {
+          center[c] += area * (p0[c] + p1[c] + p2[c]) / 3.0f;
+          normal[c] += n[c];
+        }
+        area_sum += area;
+      }
+      if (area_sum > 0.0f) {
+        for (auto c = 0u; c < 3; ++c) {
+          sort_key[k] += (center[c] / area_sum - centroid[c]) * normal[c];
+        }
+      }
+    }
+    std::vector<std::size_t> cluster_order(nclusters);
+    std::iota(cluster_order.begin(), cluster_order.end(), 0);
+    std::stable_sort(cluster_order.begin(),
+                     cluster_order.end(),
+                     [&](std::size_t a, std::size_t b) {
+                       return sort_key[a] > sort_key[b];
+                     });
+
+    std::vector<unsigned int> reordered;
+    reordered.reserve(indices.size());
+    for (const auto k : cluster_order) {
+      for (auto o = cluster_starts[k]; o < cluster_starts[k + 1]; ++o) {
+        reordered.push_back(indices[order[o] * 3 + 0]);
+        reordered.push_back(indices[order[o] * 3 + 1]);
+        reordered.push_back(indices[order[o] * 3 + 2]);
+      }
+    }
+    indices.swap(reordered);
+  }
+
+  void optimizeVertexFetch(IndexedStream& stream, std::size_t stride) {
+    const auto nvertices = stream.vertices.size() / stride;
+    const auto unused    = static_cast<unsigned int>(-1);
+    std::vector<unsigned int> remap(nvertices, unused);
+    std::vector<float>        vertices;
+    vertices.reserve(stream.vertices.size());
+    for (auto& i : stream.indices) {
+      if (remap[i] == unused) {
+        remap[i] = static_cast<unsigned int>(vertices.size() / stride);
+        vertices.insert(vertices.end(),
+                        stream.vertices.begin() + i * stride,
+                        stream.vertices.begin() + (i + 1) * stride);
+      }
+      i = remap[i];
+    }
+    stream.vertices.swap(vertices);
+  }
+
+  auto simplify(const std::vector<unsigned int>& indices,
+                const std::vector<float>&        vertices,
+                std::size_t                      stride,
+                std::size_t                      target,
+                float*                           error)
+    -> std::vector<unsigned int> {
+    const auto nvertices  = vertices.size() / stride;
+    const auto ntriangles = indices.size() / 3;
+    const auto position   = [&](unsigned int v) {
+      return &vertices[v * stride];
+    };
+
+    std::vector<unsigned char> locked(nvertices, 0);
+    {
+      // seams : one position, several attribute sets
+      std::map<std::tuple<float, float, float>, unsigned int> owner;
+      for (auto v = 0u; v < nvertices; ++v) {
+        const auto* p   = position(v);
+        const auto  key = std::make_tuple(p[0], p[1], p[2]);
+        const auto  it  = owner.find(key);
+        if (it == owner.end()) {
+          owner.emplace(key, v);
+        } else {
+          locked[v]          = 1;
+          locked[it->second] = 1;
+        }
+      }
+      // borders : edges used by a single triangle
+      std::map<std::pair<unsigned int, unsigned int>, unsigned int> uses;
+      for (auto t = 0u; t < ntriangles; ++t) {
+        for (auto e = 0u; e < 3; ++e) {
+          const auto a = indices[t * 3 + e];
+          const auto b = indices[t * 3 + (e + 1) % 3];
+          ++uses[std::minmax(a, b)];
+        }
+      }
+      for (const auto& [edge, count] : uses) {
+        if (count == 1) {
+          locked[edge.first]  = 1;
+          locked[edge.second] = 1;
+        }
+      }
+    }
+
+    std::vector<Quadric> quadrics(nvertices);
+    for (auto t = 0u; t < ntriangles; ++t) {
+      const auto* p0 = position(indices[t * 3 + 0]);
+      double      n[3];
+      triangleNormal(p0,
+                     position(indices[t * 3 + 1]),
+                     position(indices[t * 3 + 2]),
+                     n);
+      const auto length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      if (length == 0.0) {
+        continue;
+      }
+      n[0]         /= length;
+      n[1]         /= length;
+      n[2]         /= length;
+      const auto d  = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+      for (auto c = 0u; c < 3; ++c) {
+        // area weighted : large faces resist being moved
+        quadrics[indices[t * 3 + c]].addPlane(n, d, 0.5 * length);
+      }
+    }
+
+    auto                                   triangles = indices;
+    std::vector<unsigned char>             dead(ntriangles, 0);
+    std::vector<std::vector<unsigned int>> around(nvertices);
+    for (auto t = 0u; t < ntriangles; ++t) {
+      for (auto c = 0u; c < 3; ++c) {
+        around[triangles[t * 3 + c]].push_back(t);
+      }
+    }
+
+    // candidate collapse u -> v, valid while both stamps are unchanged
+    struct Collapse {
+      double       cost;
+      unsigned int u, v;
+      unsigned int stamp_u, stamp_v;
+
+      auto operator>(const Collapse& other) const -> bool {
+        return cost > other.cost;
+      }
+    };
+    std::vector<unsigned int> stamp(nvertices, 0);
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> heap;
+    const auto consider = [&](unsigned int u, unsigned int v) {
+      if (locked[u]) {
+        return;
+      }
+      auto q = quadrics[u];
+      q.add(quadrics[v]);
+      heap.push({ q.evaluate(position(v)), u, v, stamp[u], stamp[v] });
+    };
+    for (auto t = 0u; t < ntriangles; ++t) {
+      for (auto e = 0u; e < 3; ++e) {
+        const auto a = triangles[t * 3 + e];
+        const auto b = triangles[t * 3 + (e + 1) % 3];
+        consider(a, b);
+        consider(b, a);
+      }
+    }
+
+    // moving u onto v must not turn any remaining triangle of u over
+    const auto flips = [&](unsigned int u, unsigned int v) {
+      for (const auto t : around[u]) {
+        const auto* tri = &triangles[t * 3];
+        if (dead[t] || tri[0] == v || tri[1] == v || tri[2] == v) {
+          continue;
+        }
+        const float* before[3];
+        const float* after[3];
+        for (auto c = 0u; c < 3; ++c) {
+          before[c] = position(tri[c]);
+          after[c]  = tri[c] == u ? position(v) : before[c];
+        }
+        double n0[3], n1[3];
+        triangleNormal(before[0], before[1], before[2], n0);
+        triangleNormal(after[0], after[1], after[2], n1);
+        if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    auto live      = ntriangles;
+    auto max_error = 0.0;
+    while (live * 3 > target && !heap.empty()) {
+      const auto c = heap.top();
+      heap.pop();
+      if (c.stamp_u != stamp[c.u] || c.stamp_v != stamp[c.v] ||
+          flips(c.u, c.v)) {
+        continue;
+      }
+      const auto& q = quadrics[c.u];
+      if (q.weight + quadrics[c.v].weight > 0.0) {
+        max_error = std::max(max_error,
+                             c.cost / (q.weight + quadrics[c.v].weight));
+      }
+      quadrics[c.v].add(quadrics[c.u]);
+      ++stamp[c.u];
+      ++stamp[c.v];
+      // u is gone for good : a stamp that can never match again
+      stamp[c.u] = static_cast<unsigned int>(-1);
+
+      for (const auto t : around[c.u]) {
+        if (dead[t]) {
+          continue;
+        }
+        auto* tri = &triangles[t * 3];
+        for (auto k = 0u; k < 3; ++k) {
+          if (tri[k] == c.u) {
+            tri[k] = c.v;
+          }
+        }
+        if (tri[0] == tri[1] || tri[1] == tri[2] || tri[0] == tri[2]) {
+          dead[t] = 1;
+          --live;
+        } else {
+          around[c.v].push_back(t);
+        }
+      }
+      around[c.u].clear();
+
+      // the neighbourhood of v changed : requeue its edges
+      for (const auto t : around[c.v]) {
+        if (dead[t]) {
+          continue;
+        }
+        for (auto k = 0u; k < 3; ++k) {
+          const auto w = triangles[t * 3 + k];
+          if (w != c.v) {
+            consider(c.v, w);
+            consider(w, c.v);
+          }
+        }
+      }
+    }
+
+    std::vector<unsigned int> result;
+    result.reserve(live * 3);
+    for (auto t = 0u; t < ntriangles; ++t) {
+      if (!dead[t]) {
+        result.insert(result.end(),
+                      triangles.begin() + t * 3,
+                      triangles.begin() + t * 3 + 3);
+      }
+    }
+    if (error != nullptr) {
+      *error = static_cast<float>(std::sqrt(max_error));
+    }
+    return result;
+  }
+
+  auto acmr(const std::vector<unsigned int>& indices,
+            std::size_t                      nvertices,
+            unsigned int                     cache_size) -> float {
+    if (indices.size() < 3) {
+      return 0.0f;
+    }
+    // FIFO : a vertex is cached while fewer than `cache_size` misses passed
+    std::vector<std::size_t> entered(nvertices, 0);
+    std::size_t              misses = 0;
+    for (const auto i : indices) {
+      if (entered[i] == 0 || misses - entered[i] >= cache_size) {
+        ++misses;
+        entered[i] = misses;
+      }
+    }
+    return static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+  }
+
+} // namespace utils::meshopt
@@ -0,0 +1,64 @@
+#ifndef UTILS_MESHOPT_H
+#define UTILS_MESHOPT_H
+
+#include <cstddef>
+#include <vector>
+
+namespace utils::meshopt {
+
+  // post-transform vertex cache size assumed by the optimizers
+  static constexpr unsigned int VertexCacheSize { 16 };
+
+  struct IndexedStream {
+    std::vector<float>        vertices;
+    std::vector<unsigned int> indices;
+  };
+
+  /*
+   * merges bitwise-identical vertices of a non-indexed triangle stream
+   * @param stream : interleaved vertex attributes, `stride` floats per vertex
+   */
+  auto weld(const std::vector<float>& stream, std::size_t stride)
+    -> IndexedStream;
+
+  /*
+   * reorders triangles for post-transform cache locality (Tipsify), then
+   * sorts the resulting clusters front-to-back in a view-independent way
+   * to reduce overdraw (Sander et al., 2007)
+   * @param positions : the first 3 floats of every `stride` floats
+   */
+  void optimizeTriangleOrder(std::vector<unsigned int>& indices,
+                             const std::vector<float>&  vertices,
+                             std::size_t                stride,
+                             unsigned int = VertexCacheSize);
+
+  // renumbers vertices in order of first use to improve fetch locality
+  void optimizeVertexFetch(IndexedStream&, std::size_t stride);
+
+  /*
+   * quadric error metric edge collapse (Garland & Heckbert, 1997) until at
+   * most `target` indices remain; vertices sharing their position with
+   * another vertex (uv or normal seams) and vertices on open borders are
+   * locked, so seams and silhouettes of open meshes never tear; collapses
+   * are half-edge, surviving vertices keep their attributes
+   * @return indices into the same vertices
+   * @param error : receives the maximum quadric distance over all
+   *   collapses (the root of the worst weighted mean squared distance of a
+   *   moved vertex to its original planes), in position units; an upper
+   *   bound, which is what lod selection needs
+   */
+  auto simplify(const std::vector<unsigned int>& indices,
+                const std::vector<float>&        vertices,
+                std::size_t                      stride,
+                std::size_t                      target,
+                float*                           error = nullptr)
+    -> std::vector<unsigned int>;
+
+  // average cache miss ratio (transformed vertices per triangle), FIFO cache
+  auto acmr(const std::vector<unsigned int>&,
+            std::size_t  nvertices,
+            unsigned int = VertexCacheSize) -> float;
+
+} // namespace utils::meshopt
+
+#endif // UTILS_MESHOPT_H
@@ -0,0 +1,104 @@
+#include "watch.h"
+
+#include "utils/log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+#include <system_error>
+
+#if defined(__linux__)
+  #include <poll.h>
+  #include <sys/inotify.h>
+  #include <unistd.h>
+#endif
+
+namespace utils::watch {
+
+  namespace {
+    // how long the thread sleeps before checking whether it should stop
+    constexpr auto Interval = std::chrono::milliseconds(100);
+  } // namespace
+
+  FileWatcher::FileWatcher(const std::filesystem::path& dir) : m_dir { dir } {
+    m_thread = std::thread([this] { run(); });
+  }
+
+  FileWatcher::~FileWatcher() {
+    m_running.store(false, std::memory_order_release);
+    m_thread.join();
+  }
+
+  void FileWatcher::notify(const std::filesystem::path& path) {
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (std::find(m_changed.begin(), m_changed.end(), path) ==
+        m_changed.end()) {
+      m_changed.push_back(path);
+    }
+  }
+
+  auto FileWatcher::changes() -> std::vector<std::filesystem::path> {
+    std::vector<std::filesystem::path> changed;
+    {
+      std::lock_guard<std::mutex> lock { m_mutex };
+      changed.swap(m_changed);
+    }
+    return changed;
+  }
+
+#if defined(__linux__)
+  void FileWatcher::run() {
+    const auto fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 ||
+        inotify_add_watch(fd, m_dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) <
+          0) {
+      log::log(log::WARNING, "cannot watch " + m_dir.generic_string());
+      if (fd >= 0) {
+        close(fd);
+      }
+      return;
+    }
+    alignas(inotify_event) char buffer[4096];
+    while (m_running.load(std::memory_order_acquire)) {
+      pollfd request { fd, POLLIN, 0 };
+      if (poll(&request, 1, static_cast<int>(Interval.count())) <= 0) {
+        continue;
+      }
+      const auto length = read(fd, buffer, sizeof(buffer));
+      for (auto offset = ssize_t { 0 }; offset < length;) {
+        const auto* event = reinterpret_cast<const inotify_event*>(
+          buffer + offset);
+        if (event->len > 0) {
+          notify(m_dir / event->name);
+        }
+        offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+      }
+    }
+    close(fd);
+  }
+#else
+  void FileWatcher::run() {
+    std::map<std::filesystem::path, std::filesystem::file_time_type> times;
+    auto first = true;
+    while (m_running.load(std::memory_order_acquire)) {
+      std::error_code error;
+      for (const auto& entry :
+           std::filesystem::directory_iterator(m_dir, error)) {
+        const auto time = entry.last_write_time(error);
+        if (error) {
+          continue;
+        }
+        auto& known = times[entry.path()];
+        if (!first && known != time) {
+          notify(entry.path());
+        }
+        known = time;
+      }
+      first = false;
+      std::this_thread::sleep_for(Interval);
+    }
+  }
+#endif
+
+} // namespace utils::watch
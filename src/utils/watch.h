@@ -0,0 +1,42 @@
+#ifndef UTILS_WATCH_H
+#define UTILS_WATCH_H
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace utils::watch {
+
+  /*
+   * reports files written or moved into one directory, from a thread of
+   * its own; inotify on linux, modification times polled elsewhere.
+   * changes are collected until the owner drains them, so the owner never
+   * waits on the file system
+   */
+  class FileWatcher {
+    std::filesystem::path m_dir;
+
+    std::mutex                         m_mutex;
+    std::vector<std::filesystem::path> m_changed;
+
+    std::atomic<bool> m_running { true };
+    std::thread       m_thread;
+
+    void notify(const std::filesystem::path&);
+    void run();
+
+  public:
+    explicit FileWatcher(const std::filesystem::path&);
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+
+    // changed files since the last call, each listed once
+    auto changes() -> std::vector<std::filesystem::path>;
+  };
+
+} // namespace utils::watch
+
+#endif // UTILS_WATCH_H